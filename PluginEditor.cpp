@@ -5,15 +5,19 @@
 PluginEditor::PluginEditor (PluginProcessor& p)
     : AudioProcessorEditor (&p), processorRef (p)
 {
-    juce::ignoreUnused (processorRef);
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     setSize (400, 300);
     setResizable (true, false);
+
+    // telemetry is drained and formatted at the scheduler's poll rate here, on
+    // the message thread, rather than every block on the audio thread
+    scheduler->addPoll (*this, [this] { pollTelemetry(); });
 }
 
 PluginEditor::~PluginEditor()
 {
+    scheduler->removePoll (*this);
 }
 
 //==============================================================================
@@ -25,9 +29,31 @@ void PluginEditor::paint (juce::Graphics& g)
     g.setColour (juce::Colours::white);
     g.setFont (15.0f);
     g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
+
+    g.setFont (12.0f);
+    g.drawFittedText (lastTelemetry.toString(), getLocalBounds().reduced (10), juce::Justification::centredBottom, 1);
     g.drawRoundedRectangle (getLocalBounds().toFloat(), 5.0f, 1.0f);
 }
 
+void PluginEditor::pollTelemetry()
+{
+    if (processorRef.getTelemetry().popAll ([this] (const TelemetryRecord& r) { lastTelemetry = r; }) > 0)
+        scheduler->markDirty (*this);
+}
+
+void PluginEditor::parentHierarchyChanged()
+{
+    auto* holder = findParentComponentOfClass<PluginEditorComponent>();
+    auto* next   = holder != nullptr ? &holder->getRepaintScheduler() : &ownScheduler;
+
+    if (next == scheduler)
+        return;
+
+    scheduler->removePoll (*this);
+    scheduler = next;
+    scheduler->addPoll (*this, [this] { pollTelemetry(); });
+}
+
 void PluginEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
@@ -1,5 +1,6 @@
 #pragma once
 #include "PluginProcessor.h"
+#include "shared/PluginEditorComponent.h"
 
 //==============================================================================
 class PluginEditor final : public juce::AudioProcessorEditor
@@ -11,11 +12,23 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
+    void parentHierarchyChanged() override;
 
 private:
+    void pollTelemetry();
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     PluginProcessor& processorRef;
 
+    // the most recent block the processor told us about
+    TelemetryRecord lastTelemetry;
+
+    // the window's scheduler when we're in a PluginEditorComponent (i.e. the
+    // standalone app), so our repaints are flushed along with everything else's -
+    // and our own when we're in a host
+    RepaintScheduler ownScheduler;
+    RepaintScheduler* scheduler = &ownScheduler;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginEditor)
 };
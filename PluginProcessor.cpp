@@ -1,6 +1,23 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    struct FactoryPreset
+    {
+        const char* name;
+        float       gain;
+    };
+
+    const FactoryPreset factoryPresets[]
+    {
+        { "Unity",  1.0f },
+        { "-6 dB",  0.5f },
+        { "+6 dB",  2.0f },
+        { "Mute",   0.0f },
+    };
+}
+
 //==============================================================================
 PluginProcessor::PluginProcessor() : AudioProcessor
 (
@@ -13,6 +30,9 @@ PluginProcessor::PluginProcessor() : AudioProcessor
     #endif
 )
 {
+    addParameter (gain = new StoredParameter (parameterStore, { "gain", 1 }, "Gain", { 0.0f, 2.0f }, 1.0f));
+
+    presetLoader.attachToParameters();
 }
 
 PluginProcessor::~PluginProcessor()
@@ -24,42 +44,75 @@ void PluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    juce::ignoreUnused (sampleRate, samplesPerBlock);
+    parameterStore.prepare (sampleRate, samplesPerBlock);
+    presetLoader.setAudioRunning (true);
+
+    oversampler.prepare (juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()),
+                         samplesPerBlock, oversamplingFilter);
+    updateOversamplingFactor();
 }
 
 void PluginProcessor::releaseResources()
 {
+    presetLoader.setAudioRunning (false);
+
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
 }
 
+void PluginProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime (isNonRealtime);
+    updateOversamplingFactor();
+}
+
+//==============================================================================
+void PluginProcessor::setOversampling (int realtimeFactor, int offlineFactor, Oversampler::FilterType type)
+{
+    realtimeOversampling = realtimeFactor;
+    offlineOversampling  = offlineFactor;
+    oversamplingFilter   = type;
+    updateOversamplingFactor();
+}
+
+void PluginProcessor::updateOversamplingFactor()
+{
+    const auto factor = isNonRealtime() ? offlineOversampling.load() : realtimeOversampling.load();
+
+    // the audio thread picks the new factor up at the start of its next block
+    oversampler.setFactor (factor);
+    setLatencySamples (juce::roundToInt (Oversampler::getLatencyInSamples (factor, oversampler.getFilterType())));
+}
+
+void PluginProcessor::processOversampled (juce::AudioBuffer<float>& buffer)
+{
+    // This is the place for anything nonlinear (saturation, clipping, waveshaping...),
+    // which gets the buffer at the oversampled rate. The template passes it through.
+    juce::ignoreUnused (buffer);
+}
+
 void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                     juce::MidiBuffer& midiMessages)
 {
     juce::ignoreUnused (midiMessages);
 
-    const auto pos = [&]
-    {
-        if (auto* ph = getPlayHead())
-            if (auto result = ph->getPosition())
-                return *result;
+    // Don't format strings or DBG in here - that allocates and does I/O on the audio
+    // thread. Push a plain record instead, and let the message thread deal with it.
+    juce::Optional<juce::AudioPlayHead::PositionInfo> pos;
 
-        DBG ("No playhead available, using default values");
-        return juce::AudioPlayHead::PositionInfo{};
-    }();
+    if (auto* ph = getPlayHead())
+        pos = ph->getPosition();
 
-    const auto sig = pos.getTimeSignature().orFallback (juce::AudioPlayHead::TimeSignature{});
+    telemetry.push (TelemetryRecord::fromPosition (pos, buffer.getNumSamples()));
 
-    DBG (juce::String (pos.getBpm().orFallback (120.0), 2) << " bpm, "
-         << sig.numerator << '/' << sig.denominator
-         << " - " << timeToTimecodeString (pos.getTimeInSeconds().orFallback (0.0))
-         << " - " << quarterNotePositionToBarsBeatsString (pos.getPpqPosition().orFallback (0.0), sig));
+    juce::ScopedNoDenormals noDenormals;
+    const auto numSamples = buffer.getNumSamples();
 
-    if (pos.getIsRecording())     DBG ("  (is recording)");
-    if (pos.getIsPlaying())       DBG ("  (is playing)");
+    // a preset that's finished loading lands all at once, then one pass over every
+    // parameter that's moved, before any of them are used
+    presetLoader.applyPendingPreset();
+    parameterStore.beginBlock (numSamples);
 
-     
-    juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -70,7 +123,7 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     // when they first compile a plugin, but obviously you don't need to keep
     // this code if your algorithm always overwrites all the output channels.
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+        buffer.clear (i, 0, numSamples);
 
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
@@ -78,28 +131,81 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     // the samples and the outer loop is handling the channels.
     // Alternatively, you can process the samples with the channels
     // interleaved by keeping the same state.
+    const auto* gainRamp = parameterStore.getRamp (gain->getStoreIndex());
+    const auto gainValue = parameterStore.getValue (gain->getStoreIndex());
+
     for (int channel = 0; channel < totalNumInputChannels; ++channel)
     {
         auto* channelData = buffer.getWritePointer (channel);
-        juce::ignoreUnused (channelData);
-        // ..do something to the data...
+
+        if (gainRamp != nullptr)
+            juce::FloatVectorOperations::multiply (channelData, gainRamp, numSamples);
+        else if (! juce::approximatelyEqual (gainValue, 1.0f))
+            juce::FloatVectorOperations::multiply (channelData, gainValue, numSamples);
     }
+
+    // with oversampling off this hands processOversampled() the buffer itself
+    oversampler.process (buffer, numSamples, [this] (juce::AudioBuffer<float>& oversampled)
+    {
+        processOversampled (oversampled);
+    });
 }
 
 //==============================================================================
 void PluginProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    juce::ignoreUnused (destData);
+    // A small binary format rather than XML - with hundreds of instances in a
+    // session, this is on the critical path of every project load and autosave.
+    // See ProcessorState.h for the layout.
+    const auto& params = getParameters();
+    const auto values  = presetLoader.getLatestValues();
+
+    ProcessorState::Writer writer (destData);
+    writer.writeHeader();
+    writer.writeParameters (params.size(), [&] (int i)
+    {
+        return std::make_pair (ProcessorState::hashParameterID (*params.getUnchecked (i)), values[(size_t) i]);
+    });
 }
 
 void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    juce::ignoreUnused (data, sizeInBytes);
+    // Decoded on the preset loader's thread while we're playing in realtime, so the
+    // host doesn't wait on it. Offline it's done here, so it's in place for the next block.
+    presetLoader.load (data, sizeInBytes, isNonRealtime());
+}
+
+//==============================================================================
+int PluginProcessor::getNumPrograms()
+{
+    return (int) std::size (factoryPresets);
+}
+
+void PluginProcessor::setCurrentProgram (int index)
+{
+    if (! juce::isPositiveAndBelow (index, getNumPrograms()))
+        return;
+
+    currentProgram = index;
+
+    // programs go through the same path as host states
+    juce::MemoryBlock data;
+
+    {
+        ProcessorState::Writer writer (data);
+        writer.writeHeader();
+        writer.writeParameters (1, [&] (int)
+        {
+            return std::make_pair (ProcessorState::hashParameterID (*gain), gain->convertTo0to1 (factoryPresets[index].gain));
+        });
+    }
+
+    presetLoader.load (std::move (data), isNonRealtime());
+}
+
+const juce::String PluginProcessor::getProgramName (int index)
+{
+    return juce::isPositiveAndBelow (index, getNumPrograms()) ? factoryPresets[index].name : "";
 }
 
 
@@ -1,5 +1,10 @@
 #pragma once
 #include <juce_audio_processors/juce_audio_processors.h>
+#include "ProcessorTelemetry.h"
+#include "ProcessorState.h"
+#include "ProcessorParameters.h"
+#include "ProcessorPresets.h"
+#include "ProcessorOversampling.h"
 
 //==============================================================================
 class PluginProcessor  : public juce::AudioProcessor
@@ -12,6 +17,7 @@ public:
     //==============================================================================
     void prepareToPlay (double, int) override;
     void releaseResources() override;
+    void setNonRealtime (bool) noexcept override;
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override
     {
@@ -76,47 +82,54 @@ public:
     double getTailLengthSeconds() const override                 { return 0.0; }
 
     //==============================================================================
-    int getNumPrograms() override                                { return 1; }
-    int getCurrentProgram() override                             { return 0; }
-    void setCurrentProgram (int) override                        {}
+    int getNumPrograms() override;
+    int getCurrentProgram() override                             { return currentProgram; }
+    void setCurrentProgram (int) override;
     
     //==============================================================================
-    const juce::String getProgramName (int) override             { return {}; }
+    const juce::String getProgramName (int) override;
     void changeProgramName (int, const juce::String&) override   {}
 
     //==============================================================================
     void getStateInformation (juce::MemoryBlock&) override;
     void setStateInformation (const void*, int) override;
 
+    //==============================================================================
+    // Filled by processBlock on the audio thread, drained by the editor (or anything
+    // else on the message thread) - see ProcessorTelemetry.h
+    using Telemetry = TelemetryFifo<TelemetryRecord, 256>;
+    Telemetry& getTelemetry() noexcept                           { return telemetry; }
+
+    //==============================================================================
+    // Every parameter's value lives in here - the audio thread reads them back as
+    // smoothed ramps, see ProcessorParameters.h
+    ParameterStore& getParameterStore() noexcept                 { return parameterStore; }
+
+    //==============================================================================
+    // The nonlinear part of processBlock runs oversampled, by one factor while the host's
+    // playing in realtime and another while it renders offline (1, 2, 4 or 8). The
+    // factors take effect straight away, the filter type from the next prepareToPlay.
+    // See ProcessorOversampling.h
+    void setOversampling (int realtimeFactor, int offlineFactor, Oversampler::FilterType);
+
 private:
     //==============================================================================
-    static juce::String timeToTimecodeString (double seconds)
-    {
-        auto millisecs = juce::roundToInt (seconds * 1000.0);
-        auto absMillisecs = std::abs (millisecs);
-
-        return juce::String::formatted ("%02d:%02d:%02d.%03d",
-                                        (millisecs / 3600000),
-                                        (absMillisecs / 60000) % 60,
-                                        (absMillisecs / 1000) % 60,
-                                        (absMillisecs % 1000));
-    }
-    // quick-and-dirty function to format a bars/beats string
-    static juce::String quarterNotePositionToBarsBeatsString (double quarterNotes, 
-                                                                juce::AudioPlayHead::TimeSignature sig)
-    {
-        if (sig.numerator == 0 || sig.denominator == 0)
-            return "1|1|000";
+    void updateOversamplingFactor();
+    void processOversampled (juce::AudioBuffer<float>&);
 
-        auto quarterNotesPerBar = (sig.numerator * 4 / sig.denominator);
-        auto beats  = (fmod (quarterNotes, quarterNotesPerBar) / quarterNotesPerBar) * sig.numerator;
-        auto bar    = ((int) quarterNotes) / quarterNotesPerBar + 1;
-        auto beat   = ((int) beats) + 1;
-        auto ticks  = ((int) (fmod (beats, 1.0) * 960.0 + 0.5));
+    //==============================================================================
+    Telemetry telemetry;
 
-        return juce::String::formatted ("%d|%d|%03d", bar, beat, ticks);
-    }
+    ParameterStore parameterStore;
+    StoredParameter* gain = nullptr;
+
+    // states and programs are decoded off the host's thread while playing in realtime - see ProcessorPresets.h
+    PresetLoader presetLoader { *this, parameterStore };
+    std::atomic<int> currentProgram { 0 };
 
+    Oversampler oversampler;
+    std::atomic<int> realtimeOversampling { 1 }, offlineOversampling { 1 };
+    std::atomic<Oversampler::FilterType> oversamplingFilter { Oversampler::FilterType::firHalfBand };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginProcessor)
 };
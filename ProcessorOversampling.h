@@ -0,0 +1,588 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define OVERSAMPLER_USE_SSE2 1
+#elif defined (__aarch64__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define OVERSAMPLER_USE_NEON64 1
+#endif
+
+//==============================================================================
+/** 2x, 4x or 8x oversampling, as a cascade of 2x half-band stages, for the parts of
+    processBlock that alias (saturation, clipping, anything nonlinear).
+
+    Two kinds of half-band filter are available:
+    - firHalfBand is linear phase (so it doesn't smear transients or the phase
+      response), at the cost of more latency and more work per sample.
+    - iirHalfBand is a pair of polyphase allpass chains - very cheap and very little
+      latency, but not linear phase.
+
+    Everything's allocated in prepare() for the largest factor, so the factor can be
+    changed with setFactor() from any thread and the audio thread just switches over
+    (clearing the filters) at the start of its next block.
+*/
+class Oversampler
+{
+public:
+    enum class FilterType
+    {
+        firHalfBand,
+        iirHalfBand
+    };
+
+    static constexpr int maxNumStages = 3;
+    static constexpr int maxFactor    = 1 << maxNumStages;
+
+    //==============================================================================
+    /** Message thread, while the audio thread isn't running (i.e. from prepareToPlay). */
+    void prepare (int numChannelsIn, int maxBlockSize, FilterType type)
+    {
+        numChannels  = numChannelsIn;
+        maxNumInput  = maxBlockSize;
+        filterType   = type;
+
+        for (int s = 0; s < maxNumStages; ++s)
+        {
+            const auto maxInput = maxBlockSize << s;
+
+            firStages[(size_t) s].prepare (numChannels, maxInput, firHalfLengths[s]);
+            iirStages[(size_t) s].prepare (numChannels, iirCoefficients (s));
+            buffers[(size_t) s].setSize (juce::jmax (1, numChannels), maxInput * 2);
+        }
+
+        activeStages = -1;
+    }
+
+    /** 1, 2, 4 or 8. Any thread - it's picked up by the next processUp(). */
+    void setFactor (int newFactor) noexcept
+    {
+        jassert (newFactor == 1 || newFactor == 2 || newFactor == 4 || newFactor == 8);
+        requestedStages.store (juce::jlimit (0, maxNumStages, juce::findHighestSetBit ((juce::uint32) juce::jmax (1, newFactor))));
+    }
+
+    int getFactor() const noexcept                  { return 1 << requestedStages.load(); }
+    FilterType getFilterType() const noexcept       { return filterType; }
+
+    /** How far the round trip up and back down delays the signal, in samples at the
+        base rate. For the IIR filters this is the group delay at DC.
+    */
+    static double getLatencyInSamples (int factor, FilterType type)
+    {
+        auto latency = 0.0;
+
+        for (int s = 0; (2 << s) <= factor && s < maxNumStages; ++s)
+        {
+            if (type == FilterType::firHalfBand)
+            {
+                // each half-band filter delays by (its length - 1) / 2 at the higher rate
+                latency += (2 * firHalfLengths[s] - 1) / (double) (1 << s);
+            }
+            else
+            {
+                auto stageLatency = 0.5;
+
+                for (auto a : iirCoefficients (s))
+                    stageLatency += (1.0 - a) / (1.0 + a);
+
+                latency += stageLatency / (double) (1 << s);
+            }
+        }
+
+        return latency;
+    }
+
+    double getLatencyInSamples() const              { return getLatencyInSamples (getFactor(), filterType); }
+
+    //==============================================================================
+    /** Audio thread. Runs the first numSamples of `buffer` up to the oversampled rate,
+        calls processOversampled with the result to process in place, and brings it
+        back down. A block bigger than prepare() was told to expect (which some hosts
+        do send) is done in pieces of that size, so nothing's written past the end of
+        the stage buffers.
+    */
+    template <typename ProcessFn>
+    void process (juce::AudioBuffer<float>& buffer, int numSamples, ProcessFn&& processOversampled) noexcept
+    {
+        const auto chunkSize = maxNumInput > 0 ? maxNumInput : numSamples;
+
+        for (int start = 0; start < numSamples;)
+        {
+            const auto num = juce::jmin (chunkSize, numSamples - start);
+            juce::AudioBuffer<float> chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, num);
+
+            auto oversampled = processUp (chunk, num);
+            processOversampled (oversampled);
+            processDown (chunk, num);
+
+            start += num;
+        }
+    }
+
+    /** Audio thread. Upsamples the first numSamples of `input` and returns a buffer of
+        numSamples * getFactor() samples to process in place, then pass to processDown().
+        numSamples mustn't be more than prepare()'s maxBlockSize - process() takes care
+        of splitting up bigger blocks.
+    */
+    juce::AudioBuffer<float> processUp (juce::AudioBuffer<float>& input, int numSamples) noexcept
+    {
+        jassert (input.getNumChannels() >= numChannels && numSamples <= maxNumInput);
+
+        const auto stages = requestedStages.load();
+
+        if (stages != activeStages)
+        {
+            activeStages = stages;
+            reset();
+        }
+
+        if (activeStages == 0)
+            return juce::AudioBuffer<float> (input.getArrayOfWritePointers(), numChannels, numSamples);
+
+        auto* const* source = input.getArrayOfReadPointers();
+
+        for (int s = 0; s < activeStages; ++s)
+        {
+            auto* const* dest = buffers[(size_t) s].getArrayOfWritePointers();
+
+            if (filterType == FilterType::firHalfBand)
+                firStages[(size_t) s].processUp (source, dest, numSamples << s);
+            else
+                iirStages[(size_t) s].processUp (source, dest, numSamples << s);
+
+            source = buffers[(size_t) s].getArrayOfReadPointers();
+        }
+
+        return juce::AudioBuffer<float> (buffers[(size_t) activeStages - 1].getArrayOfWritePointers(),
+                                         numChannels, numSamples << activeStages);
+    }
+
+    /** Audio thread. Brings the buffer processUp() returned back down into `output`. */
+    void processDown (juce::AudioBuffer<float>& output, int numSamples) noexcept
+    {
+        jassert (output.getNumChannels() >= numChannels);
+
+        for (int s = activeStages; --s >= 0;)
+        {
+            auto* const* source = buffers[(size_t) s].getArrayOfReadPointers();
+            auto* const* dest   = s > 0 ? buffers[(size_t) s - 1].getArrayOfWritePointers()
+                                        : output.getArrayOfWritePointers();
+
+            if (filterType == FilterType::firHalfBand)
+                firStages[(size_t) s].processDown (source, dest, numSamples << s);
+            else
+                iirStages[(size_t) s].processDown (source, dest, numSamples << s);
+        }
+    }
+
+    void reset() noexcept
+    {
+        for (auto& stage : firStages)   stage.reset();
+        for (auto& stage : iirStages)   stage.reset();
+    }
+
+private:
+    //==============================================================================
+    /** A linear phase half-band FIR. Every other tap of a half-band filter is zero
+        apart from the centre one, so going up, one of each pair of outputs is just a
+        delayed input and the other is a single dot product; coming down, the odd
+        inputs only ever meet the centre tap. The dot products are done four at a time.
+    */
+    struct FirHalfBand
+    {
+        void prepare (int numChannelsIn, int maxInput, int halfLengthIn)
+        {
+            numChannels = numChannelsIn;
+            halfLength  = halfLengthIn;
+
+            const auto numTaps = 2 * halfLength;        // the non-zero ones either side of the centre
+            const auto centre  = numTaps - 1;           // of the full 4 * halfLength - 1 tap filter
+
+            taps.setSize (1, numTaps);
+            auto sum = 0.0;
+
+            for (int t = 0; t < numTaps; ++t)
+            {
+                const auto x      = 2 * t - centre;     // always odd, so never the centre
+                const auto ratio  = (double) (2 * t) / centre - 1.0;
+                const auto sinc   = std::sin (juce::MathConstants<double>::halfPi * x) / (juce::MathConstants<double>::pi * x);
+                const auto window = besselI0 (kaiserBeta * std::sqrt (juce::jmax (0.0, 1.0 - ratio * ratio))) / besselI0 (kaiserBeta);
+
+                taps.setSample (0, numTaps - 1 - t, (float) (sinc * window));   // newest sample last
+                sum += sinc * window;
+            }
+
+            // so the filtered phase has a gain of exactly 0.5 at DC, like the centre tap
+            taps.applyGain ((float) (0.5 / sum));
+
+            const auto historySize = numTaps - 1;
+            upHistory  .setSize (juce::jmax (1, numChannels), historySize + maxInput);
+            evenHistory.setSize (juce::jmax (1, numChannels), historySize + maxInput);
+            oddHistory .setSize (juce::jmax (1, numChannels), historySize + maxInput);
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            upHistory.clear();
+            evenHistory.clear();
+            oddHistory.clear();
+        }
+
+        void processUp (const float* const* input, float* const* output, int numSamples) noexcept
+        {
+            const auto historySize = 2 * halfLength - 1;
+            const auto* coeffs = taps.getReadPointer (0);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* history = upHistory.getWritePointer (ch);
+                auto* out     = output[ch];
+
+                juce::FloatVectorOperations::copy (history + historySize, input[ch], numSamples);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    out[2 * i]     = 2.0f * dotProduct (history + i, coeffs, 2 * halfLength);
+                    out[2 * i + 1] = history[i + halfLength];
+                }
+
+                std::memmove (history, history + numSamples, sizeof (float) * (size_t) historySize);
+            }
+        }
+
+        void processDown (const float* const* input, float* const* output, int numSamples) noexcept
+        {
+            const auto historySize = 2 * halfLength - 1;
+            const auto* coeffs = taps.getReadPointer (0);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* even = evenHistory.getWritePointer (ch);
+                auto* odd  = oddHistory .getWritePointer (ch);
+                const auto* in = input[ch];
+                auto* out = output[ch];
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    even[historySize + i] = in[2 * i];
+                    odd [historySize + i] = in[2 * i + 1];
+                }
+
+                for (int i = 0; i < numSamples; ++i)
+                    out[i] = dotProduct (even + i, coeffs, 2 * halfLength) + 0.5f * odd[i + halfLength - 1];
+
+                std::memmove (even, even + numSamples, sizeof (float) * (size_t) historySize);
+                std::memmove (odd,  odd  + numSamples, sizeof (float) * (size_t) historySize);
+            }
+        }
+
+        static float dotProduct (const float* a, const float* b, int num) noexcept
+        {
+            jassert (num % 4 == 0);
+
+           #if OVERSAMPLER_USE_SSE2
+            auto acc = _mm_setzero_ps();
+
+            for (int i = 0; i < num; i += 4)
+                acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+
+            acc = _mm_add_ps (acc, _mm_movehl_ps (acc, acc));
+            acc = _mm_add_ss (acc, _mm_shuffle_ps (acc, acc, 1));
+            return _mm_cvtss_f32 (acc);
+           #elif OVERSAMPLER_USE_NEON64
+            auto acc = vdupq_n_f32 (0.0f);
+
+            for (int i = 0; i < num; i += 4)
+                acc = vfmaq_f32 (acc, vld1q_f32 (a + i), vld1q_f32 (b + i));
+
+            return vaddvq_f32 (acc);
+           #else
+            auto acc = 0.0f;
+
+            for (int i = 0; i < num; ++i)
+                acc += a[i] * b[i];
+
+            return acc;
+           #endif
+        }
+
+        static double besselI0 (double x) noexcept
+        {
+            double sum = 1.0, term = 1.0;
+
+            for (int k = 1; k < 50 && term > sum * 1.0e-12; ++k)
+            {
+                term *= (x * 0.5 / k) * (x * 0.5 / k);
+                sum  += term;
+            }
+
+            return sum;
+        }
+
+        static constexpr double kaiserBeta = 8.0;
+
+        int                         numChannels = 0, halfLength = 0;
+        juce::AudioBuffer<float>    taps, upHistory, evenHistory, oddHistory;
+    };
+
+    //==============================================================================
+    /** A polyphase IIR half-band: two chains of first order allpasses, one of them a
+        sample behind the other, whose average is the low-pass. Going up each input is
+        run through both chains to make the pair of outputs; coming down, the even and
+        odd inputs go through one chain each and are averaged.
+
+        The recursion can't be vectorised along time, so the vector lanes are the two
+        chains of two channels instead - a stereo pair runs through every section of
+        both chains with a single multiply-add.
+    */
+    struct IirHalfBand
+    {
+        static constexpr int maxSections = 4;   // per chain
+
+        void prepare (int numChannelsIn, const std::vector<double>& coefficients)
+        {
+            jassert (coefficients.size() % 2 == 0 && (int) coefficients.size() <= 2 * maxSections);
+
+            numChannels = numChannelsIn;
+            numSections = (int) coefficients.size() / 2;
+
+            for (int s = 0; s < numSections; ++s)
+                for (int lane = 0; lane < 4; ++lane)
+                    coeffs[s][lane] = (float) coefficients[(size_t) (2 * s + (lane & 1))];
+
+            const auto numPairs = (numChannels + 1) / 2;
+            upState  .assign ((size_t) numPairs, {});
+            downState.assign ((size_t) numPairs, {});
+        }
+
+        void reset() noexcept
+        {
+            std::fill (upState.begin(),   upState.end(),   PairState {});
+            std::fill (downState.begin(), downState.end(), PairState {});
+        }
+
+        void processUp (const float* const* input, float* const* output, int numSamples) noexcept
+        {
+            for (int ch = 0; ch < numChannels; ch += 2)
+            {
+                const auto* in0 = input[ch];
+                const auto* in1 = ch + 1 < numChannels ? input[ch + 1] : in0;
+                auto* out0 = output[ch];
+                auto* out1 = ch + 1 < numChannels ? output[ch + 1] : nullptr;
+
+                runPair (upState[(size_t) ch / 2], numSamples, [&] (int i, float* lanes)
+                {
+                    lanes[0] = lanes[1] = in0[i];
+                    lanes[2] = lanes[3] = in1[i];
+                },
+                [&] (int i, const float* lanes)
+                {
+                    out0[2 * i] = lanes[0];
+                    out0[2 * i + 1] = lanes[1];
+
+                    if (out1 != nullptr)
+                    {
+                        out1[2 * i] = lanes[2];
+                        out1[2 * i + 1] = lanes[3];
+                    }
+                });
+            }
+        }
+
+        void processDown (const float* const* input, float* const* output, int numSamples) noexcept
+        {
+            for (int ch = 0; ch < numChannels; ch += 2)
+            {
+                const auto* in0 = input[ch];
+                const auto* in1 = ch + 1 < numChannels ? input[ch + 1] : in0;
+                auto* out0 = output[ch];
+                auto* out1 = ch + 1 < numChannels ? output[ch + 1] : nullptr;
+
+                runPair (downState[(size_t) ch / 2], numSamples, [&] (int i, float* lanes)
+                {
+                    lanes[0] = in0[2 * i + 1];
+                    lanes[1] = in0[2 * i];
+                    lanes[2] = in1[2 * i + 1];
+                    lanes[3] = in1[2 * i];
+                },
+                [&] (int i, const float* lanes)
+                {
+                    out0[i] = 0.5f * (lanes[0] + lanes[1]);
+
+                    if (out1 != nullptr)
+                        out1[i] = 0.5f * (lanes[2] + lanes[3]);
+                });
+            }
+        }
+
+    private:
+        struct PairState
+        {
+            alignas (16) float x[maxSections][4] {}, y[maxSections][4] {};
+        };
+
+        /** Runs every section over numSamples vectors, with `read` filling the four
+            lanes for each sample and `write` taking them back out.
+        */
+        template <typename Read, typename Write>
+        void runPair (PairState& state, int numSamples, Read&& read, Write&& write) const noexcept
+        {
+            alignas (16) float lanes[4];
+
+           #if OVERSAMPLER_USE_SSE2
+            __m128 a[maxSections], x[maxSections], y[maxSections];
+
+            for (int s = 0; s < numSections; ++s)
+            {
+                a[s] = _mm_load_ps (coeffs[s]);
+                x[s] = _mm_load_ps (state.x[s]);
+                y[s] = _mm_load_ps (state.y[s]);
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                read (i, lanes);
+                auto v = _mm_load_ps (lanes);
+
+                for (int s = 0; s < numSections; ++s)
+                {
+                    const auto out = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (v, y[s]), a[s]), x[s]);
+                    x[s] = v;
+                    y[s] = out;
+                    v    = out;
+                }
+
+                _mm_store_ps (lanes, v);
+                write (i, lanes);
+            }
+
+            for (int s = 0; s < numSections; ++s)
+            {
+                _mm_store_ps (state.x[s], x[s]);
+                _mm_store_ps (state.y[s], y[s]);
+            }
+           #elif OVERSAMPLER_USE_NEON64
+            float32x4_t a[maxSections], x[maxSections], y[maxSections];
+
+            for (int s = 0; s < numSections; ++s)
+            {
+                a[s] = vld1q_f32 (coeffs[s]);
+                x[s] = vld1q_f32 (state.x[s]);
+                y[s] = vld1q_f32 (state.y[s]);
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                read (i, lanes);
+                auto v = vld1q_f32 (lanes);
+
+                for (int s = 0; s < numSections; ++s)
+                {
+                    const auto out = vfmaq_f32 (x[s], vsubq_f32 (v, y[s]), a[s]);
+                    x[s] = v;
+                    y[s] = out;
+                    v    = out;
+                }
+
+                vst1q_f32 (lanes, v);
+                write (i, lanes);
+            }
+
+            for (int s = 0; s < numSections; ++s)
+            {
+                vst1q_f32 (state.x[s], x[s]);
+                vst1q_f32 (state.y[s], y[s]);
+            }
+           #else
+            for (int i = 0; i < numSamples; ++i)
+            {
+                read (i, lanes);
+
+                for (int s = 0; s < numSections; ++s)
+                {
+                    for (int lane = 0; lane < 4; ++lane)
+                    {
+                        const auto out = (lanes[lane] - state.y[s][lane]) * coeffs[s][lane] + state.x[s][lane];
+                        state.x[s][lane] = lanes[lane];
+                        state.y[s][lane] = out;
+                        lanes[lane] = out;
+                    }
+                }
+
+                write (i, lanes);
+            }
+           #endif
+        }
+
+        int                         numChannels = 0, numSections = 0;
+        alignas (16) float          coeffs[maxSections][4] {};
+        std::vector<PairState>      upState, downState;
+    };
+
+    //==============================================================================
+    /** The allpass coefficients for each stage, designed once with the elliptic
+        half-band method from Valenzuela and Constantinides (as used in HIIR). The
+        first stage has the narrowest transition band, so it needs the most sections.
+    */
+    static const std::vector<double>& iirCoefficients (int stage)
+    {
+        static const std::vector<double> coefficients[maxNumStages]
+        {
+            designIirHalfBand (8, 0.04),
+            designIirHalfBand (4, 0.2),
+            designIirHalfBand (4, 0.3)
+        };
+
+        return coefficients[stage];
+    }
+
+    static std::vector<double> designIirHalfBand (int numCoefficients, double transition)
+    {
+        const auto pi = juce::MathConstants<double>::pi;
+
+        auto k = std::tan ((1.0 - 2.0 * transition) * pi / 4.0);
+        k *= k;
+        const auto kksqrt = std::pow (1.0 - k * k, 0.25);
+        const auto e  = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+        const auto e4 = e * e * e * e;
+        const auto q  = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+        const auto order = 2 * numCoefficients + 1;
+        std::vector<double> result;
+
+        for (int c = 1; c <= numCoefficients; ++c)
+        {
+            auto num = 0.0, den = 0.0;
+
+            for (int i = 0; i < 20; ++i)
+                num += std::pow (q, i * (i + 1)) * std::sin ((2 * i + 1) * c * pi / order) * ((i & 1) != 0 ? -1.0 : 1.0);
+
+            for (int i = 1; i < 20; ++i)
+                den += std::pow (q, i * i) * std::cos (2 * i * c * pi / order) * ((i & 1) != 0 ? -1.0 : 1.0);
+
+            const auto ww   = num * std::pow (q, 0.25) / (den + 0.5);
+            const auto wwsq = ww * ww;
+            const auto x    = std::sqrt ((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+
+            result.push_back ((1.0 - x) / (1.0 + x));
+        }
+
+        return result;
+    }
+
+    // half the number of non-zero side taps for each FIR stage, which again gets
+    // away with less as the transition band widens
+    static constexpr int firHalfLengths[maxNumStages] { 16, 8, 8 };
+
+    //==============================================================================
+    int                                     numChannels = 0, maxNumInput = 0;
+    FilterType                              filterType = FilterType::firHalfBand;
+    std::array<FirHalfBand, maxNumStages>   firStages;
+    std::array<IirHalfBand, maxNumStages>   iirStages;
+    std::array<juce::AudioBuffer<float>, maxNumStages> buffers;    // the output of each stage going up
+
+    std::atomic<int>                        requestedStages { 0 };
+    int                                     activeStages = -1;     // audio thread
+};
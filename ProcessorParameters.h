@@ -0,0 +1,286 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define PARAMETER_STORE_USE_SSE2 1
+#elif defined (__aarch64__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define PARAMETER_STORE_USE_NEON64 1
+#endif
+
+//==============================================================================
+/** Every parameter value the processor has, in one contiguous array of atomics,
+    plus the smoothing that turns them into per-sample ramps on the audio thread.
+
+    Any thread (host, editor, automation) can set() a value at any time - that's a
+    relaxed store plus one bit in a dirty mask. At the start of each block the audio
+    thread calls beginBlock(), which only looks at the parameters whose bit is set
+    or that are still mid-ramp, and fills each of their ramp buffers in a single
+    vectorised pass. Everything else is skipped, so a block where nothing moved
+    costs a scan of the dirty mask and nothing more.
+
+    Smoothing is linear, like SmoothedValue<float, Linear>: a new target restarts
+    the ramp from wherever the value currently is.
+*/
+class ParameterStore
+{
+public:
+    //==============================================================================
+    /** Adds a parameter and returns its index. Only call this while nothing else is
+        using the store, i.e. from the processor's constructor.
+    */
+    int addParameter (float initialValue)
+    {
+        const auto index = numParameters++;
+        const auto numWords = (numParameters + 31) / 32;
+
+        auto newTargets = std::make_unique<std::atomic<float>[]> ((size_t) numParameters);
+        auto newDirty   = std::make_unique<std::atomic<juce::uint32>[]> ((size_t) numWords);
+
+        for (int i = 0; i < index; ++i)
+            newTargets[(size_t) i].store (targets[(size_t) i].load());
+
+        for (int i = 0; i < numWords; ++i)
+            newDirty[(size_t) i].store (0);
+
+        newTargets[(size_t) index].store (initialValue);
+
+        targets    = std::move (newTargets);
+        dirtyWords = std::move (newDirty);
+
+        current.push_back (initialValue);
+        currentTarget.push_back (initialValue);
+        step.push_back (0.0f);
+        samplesRemaining.push_back (0);
+        hasRamp.push_back (0);
+        return index;
+    }
+
+    int getNumParameters() const noexcept       { return numParameters; }
+
+    /** Allocates the ramp buffers. Message thread, while the audio thread's stopped. */
+    void prepare (double sampleRate, int maximumBlockSize, double smoothingSeconds = 0.02)
+    {
+        rampLength = juce::jmax (0, juce::roundToInt (sampleRate * smoothingSeconds));
+        ramps.setSize (juce::jmax (1, numParameters), juce::jmax (1, maximumBlockSize));
+        ramping.clear();
+        ramping.reserve ((size_t) numParameters);
+
+        // whatever ramps were running are finished
+        for (int i = 0; i < numParameters; ++i)
+        {
+            current[(size_t) i] = currentTarget[(size_t) i] = targets[(size_t) i].load();
+            samplesRemaining[(size_t) i] = 0;
+            hasRamp[(size_t) i] = 0;
+        }
+    }
+
+    //==============================================================================
+    /** Any thread. */
+    void set (int index, float newValue) noexcept
+    {
+        jassert (juce::isPositiveAndBelow (index, numParameters));
+
+        targets[(size_t) index].store (newValue, std::memory_order_relaxed);
+        dirtyWords[(size_t) (index >> 5)].fetch_or (1u << (index & 31), std::memory_order_release);
+    }
+
+    /** Any thread - the value most recently set, which the audio thread may still be
+        ramping towards.
+    */
+    float getTarget (int index) const noexcept      { return targets[(size_t) index].load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Audio thread - picks up any new targets and fills the ramp buffers for every
+        parameter that's moving during the next numSamples.
+    */
+    void beginBlock (int numSamples) noexcept
+    {
+        for (auto index : ramping)
+            hasRamp[(size_t) index] = 0;
+
+        // keep anything that's still mid-ramp from last time...
+        ramping.erase (std::remove_if (ramping.begin(), ramping.end(),
+                                       [this] (int index) { return samplesRemaining[(size_t) index] == 0; }),
+                       ramping.end());
+
+        // ...and add whatever's been set since
+        const auto numWords = (numParameters + 31) / 32;
+
+        for (int w = 0; w < numWords; ++w)
+        {
+            auto bits = dirtyWords[(size_t) w].exchange (0, std::memory_order_acquire);
+
+            while (bits != 0)
+            {
+                const auto index = w * 32 + juce::findHighestSetBit (bits & (~bits + 1)); // the lowest set bit
+                bits &= bits - 1;
+
+                startRamp (index, targets[(size_t) index].load (std::memory_order_relaxed));
+            }
+        }
+
+        if (numSamples <= 0)
+            return;
+
+        // a block bigger than we were prepared for just jumps straight to its targets
+        const auto canRamp = numSamples <= ramps.getNumSamples();
+        jassert (canRamp);
+
+        for (auto index : ramping)
+        {
+            const auto i = (size_t) index;
+
+            if (! canRamp)
+            {
+                current[i] = currentTarget[i];
+                samplesRemaining[i] = 0;
+                continue;
+            }
+
+            auto* dest = ramps.getWritePointer (index);
+            const auto numRamped = juce::jmin (numSamples, samplesRemaining[i]);
+
+            fillRamp (dest, current[i], step[i], numRamped);
+            samplesRemaining[i] -= numRamped;
+
+            if (samplesRemaining[i] == 0)
+            {
+                current[i] = currentTarget[i];
+                juce::FloatVectorOperations::fill (dest + numRamped, current[i], numSamples - numRamped);
+            }
+            else
+            {
+                current[i] = dest[numRamped - 1];
+            }
+
+            hasRamp[i] = 1;
+        }
+    }
+
+    /** Audio thread - this block's per-sample values, or nullptr if the parameter isn't
+        moving, in which case getValue() holds for the whole block.
+    */
+    const float* getRamp (int index) const noexcept
+    {
+        return hasRamp[(size_t) index] != 0 ? ramps.getReadPointer (index) : nullptr;
+    }
+
+    /** Audio thread - the value at the end of the current block. */
+    float getValue (int index) const noexcept       { return current[(size_t) index]; }
+
+    int getNumRamping() const noexcept              { return (int) ramping.size(); }
+
+    //==============================================================================
+    /** dest[i] = start + increment * (i + 1), four samples at a time where possible. */
+    static void fillRamp (float* dest, float start, float increment, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if PARAMETER_STORE_USE_SSE2
+        const auto base  = _mm_set1_ps (start);
+        const auto delta = _mm_set1_ps (increment);
+        const auto four  = _mm_set1_ps (4.0f);
+        auto n = _mm_setr_ps (1.0f, 2.0f, 3.0f, 4.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            _mm_storeu_ps (dest + i, _mm_add_ps (base, _mm_mul_ps (delta, n)));
+            n = _mm_add_ps (n, four);
+        }
+       #elif PARAMETER_STORE_USE_NEON64
+        const float firstFour[] { 1.0f, 2.0f, 3.0f, 4.0f };
+        const auto base  = vdupq_n_f32 (start);
+        const auto delta = vdupq_n_f32 (increment);
+        const auto four  = vdupq_n_f32 (4.0f);
+        auto n = vld1q_f32 (firstFour);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            vst1q_f32 (dest + i, vfmaq_f32 (base, delta, n));
+            n = vaddq_f32 (n, four);
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = start + increment * (float) (i + 1);
+    }
+
+private:
+    //==============================================================================
+    void startRamp (int index, float target) noexcept
+    {
+        const auto i = (size_t) index;
+
+        if (target == currentTarget[i])
+            return;
+
+        currentTarget[i] = target;
+
+        if (rampLength == 0)
+        {
+            current[i] = target;
+            return;
+        }
+
+        if (samplesRemaining[i] == 0)
+            ramping.push_back (index);  // reserved in prepare, so this never allocates
+
+        step[i] = (target - current[i]) / (float) rampLength;
+        samplesRemaining[i] = rampLength;
+    }
+
+    //==============================================================================
+    int                                             numParameters = 0;
+    std::unique_ptr<std::atomic<float>[]>           targets;
+    std::unique_ptr<std::atomic<juce::uint32>[]>    dirtyWords;
+
+    // audio thread only (sized in addParameter/prepare)
+    std::vector<float>          current, currentTarget, step;
+    std::vector<int>            samplesRemaining;
+    std::vector<juce::uint8>    hasRamp;
+    std::vector<int>            ramping;
+    juce::AudioBuffer<float>    ramps;
+    int                         rampLength = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ParameterStore)
+};
+
+
+//==============================================================================
+/** An AudioParameterFloat that keeps its value in a ParameterStore, so the audio
+    thread reads it (smoothed) from there rather than from the parameter object.
+    The store holds the parameter's real value, not the normalised 0-1 one.
+*/
+class StoredParameter  : public juce::AudioParameterFloat
+{
+public:
+    StoredParameter (ParameterStore& storeIn, const juce::ParameterID& parameterID, const juce::String& name,
+                     juce::NormalisableRange<float> range, float defaultValue)
+        : AudioParameterFloat (parameterID, name, range, defaultValue),
+          store (storeIn), index (storeIn.addParameter (defaultValue)) {}
+
+    int getStoreIndex() const noexcept              { return index; }
+
+    /** Updates the parameter and tells the host, but leaves the store alone - for when
+        the store's being given the value some other way (see PresetLoader). Message
+        thread only.
+    */
+    void setValueNotifyingHostOnly (float newValue)
+    {
+        const juce::ScopedValueSetter<bool> svs (updatesStore, false);
+        setValueNotifyingHost (newValue);
+    }
+
+private:
+    void valueChanged (float newValue) override
+    {
+        if (updatesStore)
+            store.set (index, newValue);
+    }
+
+    ParameterStore& store;
+    const int       index;
+    bool            updatesStore = true;
+};
@@ -0,0 +1,351 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "ProcessorState.h"
+#include "ProcessorParameters.h"
+
+//==============================================================================
+/** Loads presets (host states or programs) on a background thread while the audio's
+    running in realtime, so neither the host nor the audio thread has to wait for
+    them to be parsed. With no audio running, or while the host's rendering offline,
+    they're decoded on the calling thread instead, so the host sees the new state as
+    soon as the call returns.
+
+    Each load is decoded into a complete Snapshot of every parameter, which is handed
+    to the audio thread with a single atomic exchange. The audio thread picks it up at
+    the start of its next block and moves the whole preset into the ParameterStore at
+    once, so a preset never lands half in one block and half in the next. The
+    parameter objects the host and editor see are brought into line on the message
+    thread as soon as it's decoded.
+
+    A parameter that's changed (by the user or the host) after a preset's decoded
+    keeps its new value - the preset doesn't overwrite it when it lands.
+
+    Snapshots are only ever freed on the worker or the message thread - the audio
+    thread just marks them as applied.
+*/
+class PresetLoader  : private juce::AudioProcessorParameter::Listener,
+                      private juce::AsyncUpdater,
+                      private juce::Timer
+{
+public:
+    PresetLoader (juce::AudioProcessor& p, ParameterStore& s)
+        : processor (p), store (s) {}
+
+    ~PresetLoader() override
+    {
+        pool.removeAllJobs (true, 5000);
+        cancelPendingUpdate();
+        stopTimer();
+
+        if (numEdits != nullptr)
+            for (auto* param : processor.getParameters())
+                param->removeListener (this);
+    }
+
+    /** Starts keeping track of edits to the processor's parameters. Call this once
+        they've all been added, i.e. at the end of the processor's constructor.
+    */
+    void attachToParameters()
+    {
+        const auto& params = processor.getParameters();
+        numEdits = std::make_unique<std::atomic<juce::uint32>[]> ((size_t) params.size());
+
+        for (auto* param : params)
+            param->addListener (this);
+    }
+
+    //==============================================================================
+    /** Any thread - copies the data, so it doesn't need to outlive the call. If
+        `synchronous` is true (e.g. the host's rendering offline), or there's no audio
+        running, the preset's decoded before this returns.
+    */
+    void load (const void* data, int sizeInBytes, bool synchronous)
+    {
+        load (juce::MemoryBlock (data, (size_t) juce::jmax (0, sizeInBytes)), synchronous);
+    }
+
+    void load (juce::MemoryBlock data, bool synchronous)
+    {
+        jassert (numEdits != nullptr); // call attachToParameters() first!
+
+        {
+            const juce::ScopedLock sl (lock);
+            queued.push_back (std::move (data));
+        }
+
+        if (synchronous || ! audioRunning.load())
+            decodeQueued();
+        else
+            pool.addJob ([this] { decodeQueued(); });
+    }
+
+    /** Let the loader know whether there's an audio thread to hand presets to (i.e.
+        between prepareToPlay and releaseResources). When there isn't, presets go
+        straight into the store.
+    */
+    void setAudioRunning (bool isRunning) noexcept
+    {
+        audioRunning.store (isRunning);
+
+        if (! isRunning)
+            triggerAsyncUpdate();
+    }
+
+    //==============================================================================
+    /** Audio thread, at the start of each block. */
+    void applyPendingPreset() noexcept
+    {
+        if (auto* snapshot = pending.exchange (nullptr, std::memory_order_acq_rel))
+            apply (*snapshot);
+    }
+
+    //==============================================================================
+    /** The normalised value each of the processor's parameters will have once every
+        load that's been asked for has landed - i.e. what a saved state should contain,
+        even if the host asks for it before the audio thread or the parameter objects
+        have caught up. Any thread - a load the worker hasn't got to yet is decoded
+        here rather than waited for.
+
+        This is called while the host's saving state, so it never touches the
+        parameter objects - the values are read straight out of the latest snapshot,
+        and the parameters are left for the async update to bring into line.
+    */
+    std::vector<float> getLatestValues()
+    {
+        const juce::ScopedLock sl (lock);
+
+        decodeQueued (false);
+        return getCurrentValues();
+    }
+
+private:
+    //==============================================================================
+    struct StoreValue
+    {
+        int     parameter, storeIndex;
+        float   value;                                      // the real value, not 0-1
+    };
+
+    struct Snapshot
+    {
+        std::vector<float>                  normalised;     // one per processor parameter
+        std::vector<juce::uint32>           editsWhenDecoded;
+        std::vector<StoreValue>             storeValues;
+        bool                                synced = false; // guarded by lock
+        std::atomic<bool>                   applied { false };
+    };
+
+    /** Any thread - whether the parameter's been changed since the snapshot was decoded. */
+    bool wasEditedSince (const Snapshot& snapshot, int parameter) const noexcept
+    {
+        return numEdits != nullptr
+                && numEdits[(size_t) parameter].load (std::memory_order_acquire) != snapshot.editsWhenDecoded[(size_t) parameter];
+    }
+
+    void apply (Snapshot& snapshot) noexcept
+    {
+        for (const auto& v : snapshot.storeValues)
+            if (! wasEditedSince (snapshot, v.parameter))
+                store.set (v.storeIndex, v.value);
+
+        snapshot.applied.store (true, std::memory_order_release);
+    }
+
+    /** If nothing's going to pick the snapshot up, puts it in the store ourselves. */
+    void applyIfNoAudio (Snapshot& snapshot)
+    {
+        if (audioRunning.load())
+            return;
+
+        auto* expected = &snapshot;
+
+        if (pending.compare_exchange_strong (expected, nullptr))
+            apply (snapshot);
+    }
+
+    //==============================================================================
+    // any of these with the lock held
+
+    /** The parameters' values, with the latest snapshot on top if they've not been
+        brought into line with it yet.
+    */
+    std::vector<float> getCurrentValues() const
+    {
+        const auto& params = processor.getParameters();
+        std::vector<float> values;
+
+        for (auto* p : params)
+            values.push_back (p->getValue());
+
+        if (! snapshots.empty() && ! snapshots.back()->synced)
+        {
+            const auto& latest = *snapshots.back();
+
+            for (int i = 0; i < params.size(); ++i)
+                if (! wasEditedSince (latest, i))
+                    values[(size_t) i] = latest.normalised[(size_t) i];
+        }
+
+        return values;
+    }
+
+    /** With syncHere set (and on the message thread), the parameter objects are
+        brought into line before this returns - otherwise it's left to the async update.
+    */
+    void decodeQueued (bool syncHere = true)
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (queued.empty())
+            return;
+
+        for (const auto& data : queued)
+            buildSnapshot (data);
+
+        queued.clear();
+
+        if (snapshots.empty())
+            return;
+
+        applyIfNoAudio (*snapshots.back());
+
+        if (syncHere && juce::MessageManager::existsAndIsCurrentThread())
+            handleAsyncUpdate();
+        else
+            triggerAsyncUpdate();
+    }
+
+    void buildSnapshot (const juce::MemoryBlock& data)
+    {
+        const auto reader = ProcessorState::Reader::open (data.getData(), (int) data.getSize());
+
+        // anything that isn't ours, or is from an incompatible version, is ignored
+        if (! reader.has_value())
+            return;
+
+        const auto& params = processor.getParameters();
+
+        // start from where the last preset (or the parameters themselves) left off,
+        // so anything missing from this one stays as it is
+        auto snapshot = std::make_unique<Snapshot>();
+        snapshot->normalised = getCurrentValues();
+
+        for (int i = 0; i < params.size(); ++i)
+            snapshot->editsWhenDecoded.push_back (numEdits != nullptr ? numEdits[(size_t) i].load() : 0);
+
+        reader->matchParameters (params, [&] (int index, float value)
+        {
+            snapshot->normalised[(size_t) index] = value;
+        });
+
+        for (int i = 0; i < params.size(); ++i)
+            if (auto* stored = dynamic_cast<StoredParameter*> (params.getUnchecked (i)))
+                snapshot->storeValues.push_back ({ i, stored->getStoreIndex(),
+                                                   stored->convertFrom0to1 (snapshot->normalised[(size_t) i]) });
+
+        auto* published = snapshot.get();
+        snapshots.push_back (std::move (snapshot));
+
+        // if the audio thread never got round to the previous one, this replaces it
+        if (auto* superseded = pending.exchange (published, std::memory_order_acq_rel))
+            superseded->applied.store (true);
+    }
+
+    //==============================================================================
+    // message thread
+    void handleAsyncUpdate() override
+    {
+        if (! syncParameters())
+            startTimer (5);
+    }
+
+    void timerCallback() override
+    {
+        if (syncParameters())
+            stopTimer();
+    }
+
+    /** Updates the parameter objects to match the latest snapshot (just the once, so
+        anything changed since isn't put back), and frees every snapshot the audio
+        thread's finished with. Returns false if it's still waiting on some.
+    */
+    bool syncParameters()
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (snapshots.empty())
+            return true;
+
+        auto& latest = *snapshots.back();
+        applyIfNoAudio (latest);
+
+        if (! latest.synced)
+        {
+            latest.synced = true;
+
+            // these aren't edits, so the listener mustn't count them as such
+            syncingThread.store (juce::Thread::getCurrentThreadId());
+
+            const auto& params = processor.getParameters();
+
+            for (int i = 0; i < params.size(); ++i)
+            {
+                auto* param = params.getUnchecked (i);
+                const auto value = latest.normalised[(size_t) i];
+
+                if (wasEditedSince (latest, i) || juce::approximatelyEqual (param->getValue(), value))
+                    continue;
+
+                // the store gets the snapshot in one go on the audio thread, not one at a time from here
+                if (auto* stored = dynamic_cast<StoredParameter*> (param))
+                    stored->setValueNotifyingHostOnly (value);
+                else
+                    param->setValueNotifyingHost (value);
+            }
+
+            syncingThread.store (nullptr);
+        }
+
+        // superseded snapshots are marked as applied too, so nothing else references these
+        snapshots.erase (std::remove_if (snapshots.begin(), snapshots.end(),
+                                         [] (const auto& s) { return s->applied.load (std::memory_order_acquire); }),
+                         snapshots.end());
+
+        return snapshots.empty();
+    }
+
+    //==============================================================================
+    // any thread
+    void parameterValueChanged (int parameterIndex, float) override
+    {
+        if (numEdits == nullptr || syncingThread.load() == juce::Thread::getCurrentThreadId())
+            return;
+
+        numEdits[(size_t) parameterIndex].fetch_add (1, std::memory_order_acq_rel);
+
+        // the audio thread may have landed a preset between the store being set and
+        // the edit being counted, so make sure the edit's what ends up there
+        if (auto* stored = dynamic_cast<StoredParameter*> (processor.getParameters()[parameterIndex]))
+            store.set (stored->getStoreIndex(), stored->get());
+    }
+
+    void parameterGestureChanged (int, bool) override {}
+
+    //==============================================================================
+    juce::AudioProcessor&                           processor;
+    ParameterStore&                                 store;
+
+    juce::CriticalSection                           lock;       // never taken by the audio thread
+    std::vector<juce::MemoryBlock>                  queued;     // waiting to be decoded
+    std::vector<std::unique_ptr<Snapshot>>          snapshots;  // oldest first
+    std::atomic<Snapshot*>                          pending { nullptr };
+    std::atomic<bool>                               audioRunning { false };
+
+    // bumped whenever a parameter's changed by anything other than the loader
+    std::unique_ptr<std::atomic<juce::uint32>[]>    numEdits;
+    std::atomic<juce::Thread::ThreadID>             syncingThread { nullptr };
+
+    juce::ThreadPool                                pool { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE (PresetLoader)
+};
@@ -0,0 +1,298 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+
+//==============================================================================
+/** A compact, versioned binary format for the processor's state.
+
+    Everything's little-endian, laid out as a short header followed by a list of
+    chunks:
+
+        header:     uint32 magic ("PlSt"), uint16 major, uint16 minor,
+                    uint32 headerSize, uint32 numChunks
+        chunk:      uint32 id, uint32 size, then `size` bytes of payload
+
+    Readers skip any header bytes and chunks they don't know about, so newer
+    versions can add to the format without breaking older builds - only a change
+    to the major version means old readers have to give up. The Reader parses
+    straight out of the host's buffer, without copying it anywhere first.
+*/
+namespace ProcessorState
+{
+    constexpr juce::uint32 magic           = 0x74536c50;   // "PlSt"
+    constexpr juce::uint16 majorVersion    = 1;
+    constexpr juce::uint16 minorVersion    = 0;
+    constexpr juce::uint32 headerSize      = 16;
+    constexpr juce::uint32 chunkHeaderSize = 8;
+
+    /** Chunk ids are four character codes, e.g. chunkId ("PARM"). */
+    constexpr juce::uint32 chunkId (const char (&code)[5]) noexcept
+    {
+        return (juce::uint32) (juce::uint8) code[0]
+            | ((juce::uint32) (juce::uint8) code[1] << 8)
+            | ((juce::uint32) (juce::uint8) code[2] << 16)
+            | ((juce::uint32) (juce::uint8) code[3] << 24);
+    }
+
+    /** uint32 count, uint32 entrySize, then `count` entries of (uint32 idHash, float32 value).
+        Entries may grow in later minor versions - readers should step by entrySize.
+    */
+    constexpr juce::uint32 parametersChunk     = chunkId ("PARM");
+    constexpr juce::uint32 parameterEntrySize  = 8;
+
+    /** 32-bit FNV-1a over the parameter ID's UTF-8 bytes. Unlike String::hashCode this
+        is part of the format, so it must never change.
+    */
+    inline juce::uint32 hashParameterID (const juce::String& parameterID) noexcept
+    {
+        juce::uint32 hash = 2166136261u;
+
+        for (auto p = parameterID.toRawUTF8(); *p != 0; ++p)
+        {
+            hash ^= (juce::uint8) *p;
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    inline juce::uint32 hashParameterID (const juce::AudioProcessorParameter& param)
+    {
+        if (auto* hosted = dynamic_cast<const juce::HostedAudioProcessorParameter*> (&param))
+            return hashParameterID (hosted->getParameterID());
+
+        return hashParameterID (juce::String (param.getParameterIndex()));
+    }
+
+    //==============================================================================
+    /** Appends a state to a MemoryBlock - call writeHeader() first, then add chunks. */
+    class Writer
+    {
+    public:
+        explicit Writer (juce::MemoryBlock& destData)
+            : stream (destData, false) {}
+
+        ~Writer()
+        {
+            // patch in the number of chunks now we know it
+            if (headerStart >= 0)
+            {
+                const auto end = stream.getPosition();
+                stream.setPosition (headerStart + 12);
+                stream.writeInt ((int) numChunks);
+                stream.setPosition (end);
+            }
+
+            stream.flush();
+        }
+
+        void writeHeader()
+        {
+            jassert (headerStart < 0);
+            headerStart = stream.getPosition();
+
+            stream.writeInt ((int) magic);
+            stream.writeShort ((short) majorVersion);
+            stream.writeShort ((short) minorVersion);
+            stream.writeInt ((int) headerSize);
+            stream.writeInt (0);
+        }
+
+        void writeParameters (const juce::Array<juce::AudioProcessorParameter*>& params)
+        {
+            writeParameters (params.size(), [&] (int i)
+            {
+                return std::make_pair (hashParameterID (*params.getUnchecked (i)), params.getUnchecked (i)->getValue());
+            });
+        }
+
+        /** Writes numParameters entries, where getEntry (i) returns an (idHash, value) pair. */
+        template <typename Fn>
+        void writeParameters (int numParameters, Fn&& getEntry)
+        {
+            const auto count = (juce::uint32) numParameters;
+            const auto size  = 8 + count * parameterEntrySize;
+
+            stream.preallocate (stream.getDataSize() + chunkHeaderSize + size);
+            beginChunk (parametersChunk, size);
+            stream.writeInt ((int) count);
+            stream.writeInt ((int) parameterEntrySize);
+
+            for (int i = 0; i < numParameters; ++i)
+            {
+                const auto [idHash, value] = getEntry (i);
+                stream.writeInt ((int) idHash);
+                stream.writeFloat (value);
+            }
+        }
+
+        /** For anything that doesn't have a dedicated writer - `size` bytes must follow. */
+        void beginChunk (juce::uint32 id, juce::uint32 size)
+        {
+            stream.writeInt ((int) id);
+            stream.writeInt ((int) size);
+            ++numChunks;
+        }
+
+        juce::OutputStream& getStream() noexcept    { return stream; }
+
+    private:
+        juce::MemoryOutputStream    stream;
+        juce::int64                 headerStart = -1;
+        juce::uint32                numChunks = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (Writer)
+    };
+
+    //==============================================================================
+    /** A read-only view over a state the host has handed back. Nothing is copied,
+        so the data must outlive the Reader.
+    */
+    class Reader
+    {
+    public:
+        /** Returns nullopt if the data isn't ours, is truncated, or was written by an
+            incompatible (newer major) version.
+        */
+        static std::optional<Reader> open (const void* data, int sizeInBytes) noexcept
+        {
+            if (data == nullptr || sizeInBytes < (int) headerSize)
+                return std::nullopt;
+
+            const auto* bytes = static_cast<const juce::uint8*> (data);
+
+            if (readUint32 (bytes) != magic || readUint16 (bytes + 4) != majorVersion)
+                return std::nullopt;
+
+            const auto size = (size_t) sizeInBytes;
+            const auto hdr  = (size_t) readUint32 (bytes + 8);
+
+            if (hdr < headerSize || hdr > size)
+                return std::nullopt;
+
+            return Reader (bytes, size, hdr, readUint16 (bytes + 6));
+        }
+
+        juce::uint16 getMinorVersion() const noexcept   { return minor; }
+
+        /** Calls fn (id, payload, size) for every complete chunk, in order. */
+        template <typename Fn>
+        void forEachChunk (Fn&& fn) const
+        {
+            for (auto offset = firstChunk; offset + chunkHeaderSize <= size;)
+            {
+                const auto id        = readUint32 (data + offset);
+                const auto chunkSize = (size_t) readUint32 (data + offset + 4);
+                offset += chunkHeaderSize;
+
+                if (chunkSize > size - offset)
+                    return;
+
+                fn (id, data + offset, chunkSize);
+                offset += chunkSize;
+            }
+        }
+
+        /** Calls fn (idHash, value) for every parameter in the state. */
+        template <typename Fn>
+        void forEachParameter (Fn&& fn) const
+        {
+            forEachChunk ([&] (juce::uint32 id, const juce::uint8* payload, size_t chunkSize)
+            {
+                if (id != parametersChunk || chunkSize < 8)
+                    return;
+
+                const auto count     = (size_t) readUint32 (payload);
+                const auto entrySize = (size_t) readUint32 (payload + 4);
+
+                if (entrySize < parameterEntrySize)
+                    return;
+
+                const auto numEntries = juce::jmin (count, (chunkSize - 8) / entrySize);
+
+                for (size_t i = 0; i < numEntries; ++i)
+                {
+                    const auto* entry = payload + 8 + i * entrySize;
+                    fn (readUint32 (entry), readFloat (entry + 4));
+                }
+            });
+        }
+
+        /** Calls fn (parameterIndex, value) for each entry in the state that matches one of
+            `params`, and returns how many did.
+        */
+        template <typename Fn>
+        int matchParameters (const juce::Array<juce::AudioProcessorParameter*>& params, Fn&& fn) const
+        {
+            std::vector<std::pair<juce::uint32, int>> byHash;
+            byHash.reserve ((size_t) params.size());
+
+            for (int i = 0; i < params.size(); ++i)
+                byHash.emplace_back (hashParameterID (*params.getUnchecked (i)), i);
+
+            // states are normally read back by the build that wrote them, so entry i
+            // is usually parameter i - only fall back to a search when it isn't
+            auto sorted = byHash;
+            std::sort (sorted.begin(), sorted.end());
+
+            int numMatched = 0;
+            size_t entry = 0;
+
+            forEachParameter ([&] (juce::uint32 idHash, float value)
+            {
+                auto paramIndex = -1;
+
+                if (entry < byHash.size() && byHash[entry].first == idHash)
+                {
+                    paramIndex = byHash[entry].second;
+                }
+                else
+                {
+                    const auto it = std::lower_bound (sorted.begin(), sorted.end(), std::make_pair (idHash, -1));
+
+                    if (it != sorted.end() && it->first == idHash)
+                        paramIndex = it->second;
+                }
+
+                ++entry;
+
+                if (paramIndex >= 0)
+                {
+                    fn (paramIndex, juce::jlimit (0.0f, 1.0f, value));
+                    ++numMatched;
+                }
+            });
+
+            return numMatched;
+        }
+
+        /** Restores the values of whichever of `params` appear in the state, and returns
+            how many did. Parameters missing from the state are left alone.
+        */
+        int applyParameters (const juce::Array<juce::AudioProcessorParameter*>& params) const
+        {
+            return matchParameters (params, [&] (int index, float value)
+            {
+                params.getUnchecked (index)->setValueNotifyingHost (value);
+            });
+        }
+
+    private:
+        Reader (const juce::uint8* d, size_t s, size_t first, juce::uint16 minorIn) noexcept
+            : data (d), size (s), firstChunk (first), minor (minorIn) {}
+
+        static juce::uint32 readUint32 (const juce::uint8* p) noexcept     { return juce::ByteOrder::littleEndianInt (p); }
+        static juce::uint16 readUint16 (const juce::uint8* p) noexcept     { return juce::ByteOrder::littleEndianShort (p); }
+
+        static float readFloat (const juce::uint8* p) noexcept
+        {
+            const auto bits = readUint32 (p);
+            float value;
+            std::memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+        const juce::uint8*  data;
+        size_t              size, firstChunk;
+        juce::uint16        minor;
+    };
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+
+//==============================================================================
+/** A plain snapshot of what the processor saw in one block.
+
+    This is all POD so the audio thread can hand it over without allocating -
+    any formatting happens on whichever thread pops it.
+*/
+struct TelemetryRecord
+{
+    double  bpm = 120.0;
+    double  timeInSeconds = 0.0;
+    double  ppqPosition = 0.0;
+    int     numerator = 4, denominator = 4;
+    int     numSamples = 0;
+    bool    hasPosition = false, isPlaying = false, isRecording = false;
+
+    static TelemetryRecord fromPosition (const juce::Optional<juce::AudioPlayHead::PositionInfo>& pos,
+                                         int numSamples) noexcept
+    {
+        TelemetryRecord record;
+        record.numSamples = numSamples;
+
+        if (! pos.hasValue())
+            return record;
+
+        const auto sig = pos->getTimeSignature().orFallback (juce::AudioPlayHead::TimeSignature{});
+
+        record.hasPosition   = true;
+        record.bpm           = pos->getBpm().orFallback (120.0);
+        record.timeInSeconds = pos->getTimeInSeconds().orFallback (0.0);
+        record.ppqPosition   = pos->getPpqPosition().orFallback (0.0);
+        record.numerator     = sig.numerator;
+        record.denominator   = sig.denominator;
+        record.isPlaying     = pos->getIsPlaying();
+        record.isRecording   = pos->getIsRecording();
+        return record;
+    }
+
+    //==============================================================================
+    // not realtime safe - call these from the consumer side only
+    juce::String toString() const
+    {
+        if (! hasPosition)
+            return "No playhead available";
+
+        return juce::String (bpm, 2) + " bpm, "
+             + juce::String (numerator) + "/" + juce::String (denominator)
+             + " - " + timeToTimecodeString (timeInSeconds)
+             + " - " + quarterNotePositionToBarsBeatsString (ppqPosition, { numerator, denominator })
+             + (isRecording ? "  (is recording)" : "")
+             + (isPlaying   ? "  (is playing)"   : "");
+    }
+
+    static juce::String timeToTimecodeString (double seconds)
+    {
+        auto millisecs = juce::roundToInt (seconds * 1000.0);
+        auto absMillisecs = std::abs (millisecs);
+
+        return juce::String::formatted ("%02d:%02d:%02d.%03d",
+                                        (millisecs / 3600000),
+                                        (absMillisecs / 60000) % 60,
+                                        (absMillisecs / 1000) % 60,
+                                        (absMillisecs % 1000));
+    }
+
+    // quick-and-dirty function to format a bars/beats string
+    static juce::String quarterNotePositionToBarsBeatsString (double quarterNotes,
+                                                              juce::AudioPlayHead::TimeSignature sig)
+    {
+        if (sig.numerator == 0 || sig.denominator == 0)
+            return "1|1|000";
+
+        auto quarterNotesPerBar = (sig.numerator * 4 / sig.denominator);
+        auto beats  = (fmod (quarterNotes, quarterNotesPerBar) / quarterNotesPerBar) * sig.numerator;
+        auto bar    = ((int) quarterNotes) / quarterNotesPerBar + 1;
+        auto beat   = ((int) beats) + 1;
+        auto ticks  = ((int) (fmod (beats, 1.0) * 960.0 + 0.5));
+
+        return juce::String::formatted ("%d|%d|%03d", bar, beat, ticks);
+    }
+};
+
+
+//==============================================================================
+/** A single producer, single consumer queue for handing telemetry records from
+    the audio thread to the message thread.
+
+    push() never blocks or allocates - if the consumer falls behind, records are
+    dropped (and counted) rather than making the audio thread wait.
+*/
+template <typename Record, int capacity>
+class TelemetryFifo
+{
+public:
+    bool push (const Record& record) noexcept
+    {
+        const auto scope = fifo.write (1);
+
+        if (scope.blockSize1 > 0)
+        {
+            buffer[(size_t) scope.startIndex1] = record;
+            return true;
+        }
+
+        numDropped.fetch_add (1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /** Calls fn for each record waiting in the queue, oldest first. Returns
+        how many there were.
+    */
+    template <typename Fn>
+    int popAll (Fn&& fn)
+    {
+        const auto scope = fifo.read (fifo.getNumReady());
+        scope.forEach ([&] (int index) { fn (buffer[(size_t) index]); });
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+    int getNumDropped() const noexcept      { return numDropped.load (std::memory_order_relaxed); }
+
+private:
+    juce::AbstractFifo                      fifo { capacity };
+    std::array<Record, (size_t) capacity>   buffer;
+    std::atomic<int>                        numDropped { 0 };
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <iostream>
+#include <vector>
+
+//==============================================================================
+// The bits every benchmark app shares: reading its options, the percentile the
+// timings are summarised with, and the JSON report it prints (or writes to
+// --output) with what it was run on at the top.
+//==============================================================================
+namespace Benchmark
+{
+   #if JUCE_DEBUG
+    constexpr bool isDebugBuild = true;
+   #else
+    constexpr bool isDebugBuild = false;
+   #endif
+
+    /** The value `fraction` of the way through a set of timings that's already sorted. */
+    inline double percentile (const std::vector<double>& sorted, double fraction)
+    {
+        jassert (! sorted.empty());
+        const auto index = (int) std::ceil (fraction * (double) sorted.size()) - 1;
+        return sorted[(size_t) juce::jlimit (0, (int) sorted.size() - 1, index)];
+    }
+
+    /** An option like --seconds=30, or the fallback if it wasn't given. */
+    inline double getOption (const juce::ArgumentList& args, const juce::String& option, double fallback)
+    {
+        return args.containsOption (option) ? args.getValueForOption (option).getDoubleValue() : fallback;
+    }
+
+    inline int getOption (const juce::ArgumentList& args, const juce::String& option, int fallback)
+    {
+        return args.containsOption (option) ? args.getValueForOption (option).getIntValue() : fallback;
+    }
+
+    //==============================================================================
+    /** The top level of a benchmark's output. It starts off with the cpu, JUCE version
+        and build type, and the benchmark adds its settings and results.
+    */
+    struct Report
+    {
+        Report()
+        {
+            root->setProperty ("cpu",           juce::SystemStats::getCpuModel());
+            root->setProperty ("juceVersion",   juce::SystemStats::getJUCEVersion());
+            root->setProperty ("debugBuild",    isDebugBuild);
+        }
+
+        void set (const juce::Identifier& name, const juce::var& value)     { root->setProperty (name, value); }
+
+        /** Writes the report to the file given with --output, or prints it if there
+            isn't one, and returns the app's exit code - non-zero if the benchmark's
+            checks didn't pass, or the file couldn't be written.
+        */
+        int write (const juce::ArgumentList& args, bool passed = true) const
+        {
+            const auto json       = juce::JSON::toString (juce::var (root.get()));
+            const auto outputFile = args.getValueForOption ("--output");
+
+            if (outputFile.isNotEmpty())
+                return juce::File::getCurrentWorkingDirectory().getChildFile (outputFile).replaceWithText (json) && passed ? 0 : 1;
+
+            std::cout << json << std::endl;
+            return passed ? 0 : 1;
+        }
+
+        juce::DynamicObject::Ptr root { new juce::DynamicObject() };
+    };
+}
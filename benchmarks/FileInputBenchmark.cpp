@@ -0,0 +1,253 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Plays a looping WAV file into the plugin through AudioTransportPlayer's file
+// input, streamed and memory-mapped, with and without other threads hammering the
+// same disk, and with and without the transport looping round a couple of seconds
+// of it, and prints the read-ahead underruns and seeks as JSON. The render is paced
+// to real time a block at a time, like a device would drive it, and the output is
+// checked against the file so a block read from the wrong place shows up too.
+//
+// Looping round shouldn't cost a seek - or, without contention, an underrun.
+//
+// The file's written just before it's played, so it's likely to still be in the
+// page cache - the contention mostly tests the reader thread getting starved of
+// time and I/O bandwidth rather than the disk's seek time.
+//
+//  usage: file_input_benchmark [--seconds=30] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate   = 48000.0;
+    constexpr int    blockSize    = 256;
+    constexpr int    numChannels  = 2;
+    constexpr double fileSeconds  = 10.0;
+    constexpr int    numHammers   = 4;
+
+    // a tempo and loop that don't come to a whole number of samples, so the wrap moves about
+    constexpr double loopBpm      = 123.0;
+    constexpr double loopStartPpq = 2.0, loopEndPpq = 6.0;
+
+    //==============================================================================
+    /** Writes and fsyncs big chunks to its own file, and reads them back, over and over. */
+    struct DiskHammer  : public juce::Thread
+    {
+        explicit DiskHammer (int index)
+            : juce::Thread ("Disk Hammer"),
+              file (juce::File::getSpecialLocation (juce::File::tempDirectory)
+                        .getChildFile ("file_input_benchmark_hammer_" + juce::String (index) + ".tmp"))
+        {
+            juce::Random random (index);
+            random.fillBitsRandomly (chunk.getData(), chunk.getSize());
+        }
+
+        ~DiskHammer() override
+        {
+            stopThread (10000);
+            file.deleteFile();
+        }
+
+        void run() override
+        {
+            juce::MemoryBlock readBack (chunk.getSize());
+
+            while (! threadShouldExit())
+            {
+                {
+                    juce::FileOutputStream out (file);
+                    out.setPosition (0);
+                    out.truncate();
+
+                    for (int i = 0; i < 16 && ! threadShouldExit(); ++i)
+                    {
+                        out.write (chunk.getData(), chunk.getSize());
+                        out.flush();
+                    }
+                }
+
+                juce::FileInputStream in (file);
+
+                while (! threadShouldExit() && in.read (readBack.getData(), (int) readBack.getSize()) > 0)
+                    ;
+            }
+        }
+
+        juce::File          file;
+        juce::MemoryBlock   chunk { 4 * 1024 * 1024 };
+    };
+
+    //==============================================================================
+    struct BenchResult
+    {
+        int             underruns = 0, seeks = 0;
+        juce::int64     samplesMissed = 0, wrongSamples = 0;
+        bool            memoryMapped = false;
+    };
+
+    BenchResult runBenchmark (const juce::File& file, const juce::AudioBuffer<float>& source,
+                              bool useMemoryMapping, bool withContention, bool transportLoop, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        if (player.setInputFile (file, useMemoryMapping).failed())
+            return {};
+
+        // let the reader fill up before the transport starts
+        auto* input = player.getInputFile();
+
+        for (int i = 0; i < 1000 && input->getNumBlocksReady() < FileInputSource::numBlocks - 1; ++i)
+            juce::Thread::sleep (1);
+
+        std::vector<std::unique_ptr<DiskHammer>> hammers;
+
+        if (withContention)
+        {
+            for (int i = 0; i < numHammers; ++i)
+            {
+                hammers.push_back (std::make_unique<DiskHammer> (i));
+                hammers.back()->startThread();
+            }
+
+            juce::Thread::sleep (500);
+        }
+
+        const auto numBlocks = juce::roundToInt (seconds * sampleRate / blockSize);
+        juce::AudioBuffer<float> output (numChannels, numBlocks * blockSize);
+        std::vector<juce::int64> blockPositions ((size_t) numBlocks);
+
+        auto& playHead = player.getPlayHead();
+
+        if (transportLoop)
+        {
+            playHead.setBpm (loopBpm);
+            playHead.setLoopPoints (loopStartPpq, loopEndPpq);
+        }
+
+        playHead.setLooping (transportLoop);
+        playHead.play();
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            // wait until the block would be due, as if a device were asking for it
+            const auto due = start + (i * blockSize) * 1000.0 / sampleRate;
+            const auto now = juce::Time::getMillisecondCounterHiRes();
+
+            if (due > now)
+                juce::Time::waitForMillisecondCounter ((juce::uint32) due);
+
+            player.renderOffline (nullptr, output, i * blockSize, blockSize);
+            blockPositions[(size_t) i] = playHead.info.getTimeInSamples().orFallback (0);
+        }
+
+        hammers.clear();
+
+        BenchResult result;
+        result.underruns     = input->getNumUnderruns();
+        result.samplesMissed = input->getNumSamplesMissed();
+        result.seeks         = input->getNumSeeks();
+        result.memoryMapped  = input->isMemoryMapped();
+
+        // silence is what an underrun leaves behind, so only count audio from the wrong place
+        const auto length = source.getNumSamples();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < output.getNumSamples(); ++i)
+            {
+                const auto position = blockPositions[(size_t) (i / blockSize)] + i % blockSize;
+
+                if (const auto sample = output.getSample (ch, i); sample != 0.0f && sample != source.getSample (ch, (int) (position % length)))
+                    ++result.wrongSamples;
+            }
+
+        player.releaseOfflineRender();
+        player.clearInputFile();
+        player.setProcessor (nullptr);
+        return result;
+    }
+
+    juce::AudioBuffer<float> writeTestFile (const juce::File& file)
+    {
+        juce::AudioBuffer<float> source (numChannels, juce::roundToInt (fileSeconds * sampleRate));
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < source.getNumSamples(); ++i)
+                source.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        file.deleteFile();
+
+        // 32 bit float, so what's read back is bit-exact
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (new juce::FileOutputStream (file),
+                                                                              sampleRate, numChannels, 32, {}, 0));
+        jassert (writer != nullptr);
+
+        writer->writeFromAudioSampleBuffer (source, 0, source.getNumSamples());
+        return source;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 30.0);
+
+    const auto file   = juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile ("file_input_benchmark.wav");
+    const auto source = writeTestFile (file);
+
+    juce::Array<juce::var> results;
+    bool allCorrect = true;
+
+    for (auto useMemoryMapping : { false, true })
+    {
+        for (auto withContention : { false, true })
+        {
+            for (auto transportLoop : { false, true })
+            {
+                const auto result = runBenchmark (file, source, useMemoryMapping, withContention, transportLoop, seconds);
+                auto* obj = new juce::DynamicObject();
+
+                obj->setProperty ("memoryMapped",   result.memoryMapped);
+                obj->setProperty ("diskContention", withContention);
+                obj->setProperty ("transportLoop",  transportLoop);
+                obj->setProperty ("underruns",      result.underruns);
+                obj->setProperty ("samplesMissed",  result.samplesMissed);
+                obj->setProperty ("seeks",          result.seeks);
+                obj->setProperty ("wrongSamples",   result.wrongSamples);
+
+                // an underrun leaves the reader behind, which is put right with a seek
+                const auto loopedCleanly = ! transportLoop || (result.underruns > 0 ? withContention : result.seeks == 0);
+
+                allCorrect = allCorrect && result.wrongSamples == 0 && result.memoryMapped == useMemoryMapping && loopedCleanly;
+                results.add (juce::var (obj));
+            }
+        }
+    }
+
+    file.deleteFile();
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",          sampleRate);
+    report.set ("blockSize",           blockSize);
+    report.set ("readAheadBlocks",     FileInputSource::numBlocks);
+    report.set ("readAheadBlockSize",  FileInputSource::blockSize);
+    report.set ("secondsPerConfig",    seconds);
+    report.set ("allCorrect",          allCorrect);
+    report.set ("results",             results);
+
+    return report.write (args, allCorrect);
+}
@@ -0,0 +1,116 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin offline through AudioTransportPlayer with awkward device
+// buffer sizes, with the fixed block size adaptor off and at a few sizes, and
+// prints the throughput as JSON. Each run also pushes an impulse and a MIDI note
+// through, and checks that both come out exactly as late as the player says they
+// will.
+//
+//  usage: fixed_block_benchmark [--seconds=30] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    numChannels = 2;
+
+    struct BenchResult
+    {
+        double  realTimeFactor = 0;
+        int     reportedLatency = 0, measuredLatency = -1, measuredMidiLatency = -1;
+    };
+
+    BenchResult runBenchmark (int deviceBlockSize, int fixedBlockSize, int numSamples)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.setFixedBlockSize (fixedBlockSize);
+        player.prepareOfflineRender (sampleRate, deviceBlockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> input (numChannels, numSamples), output (numChannels, numSamples);
+        input.clear();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            input.setSample (ch, 0, 1.0f);
+
+        // the plugin leaves its MIDI buffer alone, so the note comes straight back out
+        juce::MidiBuffer midiIn, midiOut;
+        midiIn.addEvent (juce::MidiMessage::noteOn (1, 60, 1.0f), 0);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        player.renderOffline (&input, output, 0, numSamples, &midiIn, &midiOut);
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        BenchResult result;
+        result.realTimeFactor  = elapsed > 0 ? (numSamples / sampleRate) / elapsed : 0.0;
+        result.reportedLatency = player.getTotalLatencySamples();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (output.getSample (0, i) > 0.5f)
+            {
+                result.measuredLatency = i;
+                break;
+            }
+        }
+
+        if (! midiOut.isEmpty())
+            result.measuredMidiLatency = midiOut.getFirstEventTime();
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds    = Benchmark::getOption (args, "--seconds", 30.0);
+    const auto numSamples = juce::roundToInt (seconds * sampleRate);
+
+    const int deviceBlockSizes[] { 37, 100, 441, 512 };
+    const int fixedBlockSizes[]  { 0, 64, 256, 1024 };
+
+    juce::Array<juce::var> results;
+    bool allLatenciesMatch = true;
+
+    for (auto deviceBlockSize : deviceBlockSizes)
+    {
+        for (auto fixedBlockSize : fixedBlockSizes)
+        {
+            const auto result = runBenchmark (deviceBlockSize, fixedBlockSize, numSamples);
+            auto* obj = new juce::DynamicObject();
+
+            obj->setProperty ("deviceBlockSize",    deviceBlockSize);
+            obj->setProperty ("fixedBlockSize",     fixedBlockSize);
+            obj->setProperty ("realTimeFactor",     result.realTimeFactor);
+            obj->setProperty ("reportedLatency",    result.reportedLatency);
+            obj->setProperty ("measuredLatency",    result.measuredLatency);
+            obj->setProperty ("measuredMidiLatency", result.measuredMidiLatency);
+
+            allLatenciesMatch = allLatenciesMatch && result.reportedLatency == result.measuredLatency
+                                                  && result.reportedLatency == result.measuredMidiLatency;
+            results.add (juce::var (obj));
+        }
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",         sampleRate);
+    report.set ("secondsPerConfig",   seconds);
+    report.set ("allLatenciesMatch",  allLatenciesMatch);
+    report.set ("results",            results);
+
+    return report.write (args, allLatenciesMatch);
+}
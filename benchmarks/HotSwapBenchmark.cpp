@@ -0,0 +1,172 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin through AudioTransportPlayer a block at a time, paced to real
+// time like a device would drive it, while another thread hot-swaps between two
+// instances of it with setProcessorAsync(). Prints the worst block time with no
+// swaps going on, and the worst block time in the window after each swap, at a few
+// crossfade lengths as JSON.
+//
+// A swap should never hold the render up, so the worst block across a swap ought to
+// be about the same as the worst block without any.
+//
+//  usage: hot_swap_benchmark [--seconds=20] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate     = 48000.0;
+    constexpr int    blockSize      = 256;
+    constexpr int    numChannels    = 2;
+    constexpr int    swapIntervalMs = 250;
+
+    /** Renders numBlocks blocks, noting when each one started and how long it took. */
+    struct RenderThread  : public juce::Thread
+    {
+        RenderThread (AudioTransportPlayer& playerIn, int numBlocksIn)
+            : juce::Thread ("Hot Swap Render"), player (playerIn), numBlocks (numBlocksIn),
+              startsMs ((size_t) numBlocksIn), durationsMs ((size_t) numBlocksIn)
+        {
+        }
+
+        void run() override
+        {
+            player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+            ready.signal();
+
+            juce::AudioBuffer<float> input (numChannels, blockSize), output (numChannels, blockSize);
+            input.clear();
+
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+
+            for (int i = 0; i < numBlocks && ! threadShouldExit(); ++i)
+            {
+                // wait until the block would be due, as if a device were asking for it
+                const auto due = start + (i * blockSize) * 1000.0 / sampleRate;
+
+                if (due > juce::Time::getMillisecondCounterHiRes())
+                    juce::Time::waitForMillisecondCounter ((juce::uint32) due);
+
+                const auto before = juce::Time::getMillisecondCounterHiRes();
+                player.renderOffline (&input, output, 0, blockSize);
+
+                startsMs[(size_t) i]    = before;
+                durationsMs[(size_t) i] = juce::Time::getMillisecondCounterHiRes() - before;
+                numRendered = i + 1;
+            }
+
+            player.releaseOfflineRender();
+        }
+
+        AudioTransportPlayer&   player;
+        const int               numBlocks;
+        std::vector<double>     startsMs, durationsMs;
+        int                     numRendered = 0;
+        juce::WaitableEvent     ready;
+    };
+
+    struct BenchResult
+    {
+        int     numSwaps = 0;
+        double  baselineMaxMs = 0, meanSwapMaxMs = 0, worstSwapMaxMs = 0;
+    };
+
+    BenchResult runBenchmark (double crossfadeMs, double seconds)
+    {
+        // declared before the player, so they outlive any swap it still has in flight
+        std::unique_ptr<juce::AudioProcessor> procs[] { std::unique_ptr<juce::AudioProcessor> (createPluginFilter()),
+                                                        std::unique_ptr<juce::AudioProcessor> (createPluginFilter()) };
+        AudioTransportPlayer player;
+        player.setProcessor (procs[0].get());
+
+        RenderThread renderer (player, juce::roundToInt (seconds * sampleRate / blockSize));
+        renderer.startThread (juce::Thread::Priority::highest);
+        renderer.ready.wait (-1);
+
+        // the first half runs without any swaps, as the baseline
+        juce::Thread::sleep (juce::roundToInt (seconds * 500.0));
+
+        std::vector<double> swapTimesMs;
+
+        for (int i = 1; renderer.isThreadRunning(); ++i)
+        {
+            swapTimesMs.push_back (juce::Time::getMillisecondCounterHiRes());
+            player.setProcessorAsync (procs[i & 1].get(), crossfadeMs);
+            juce::Thread::sleep (swapIntervalMs);
+        }
+
+        renderer.waitForThreadToExit (-1);
+        player.setProcessor (nullptr);
+
+        BenchResult result;
+        size_t block = 0;
+
+        for (; block < (size_t) renderer.numRendered && (swapTimesMs.empty() || renderer.startsMs[block] < swapTimesMs.front()); ++block)
+            result.baselineMaxMs = juce::jmax (result.baselineMaxMs, renderer.durationsMs[block]);
+
+        double totalSwapMaxMs = 0;
+
+        for (size_t swap = 0; swap < swapTimesMs.size(); ++swap)
+        {
+            const auto windowEnd = swap + 1 < swapTimesMs.size() ? swapTimesMs[swap + 1]
+                                                                 : std::numeric_limits<double>::max();
+            auto worstMs = -1.0;
+
+            for (; block < (size_t) renderer.numRendered && renderer.startsMs[block] < windowEnd; ++block)
+                worstMs = juce::jmax (worstMs, renderer.durationsMs[block]);
+
+            // the render had finished before this one
+            if (worstMs < 0)
+                continue;
+
+            ++result.numSwaps;
+            totalSwapMaxMs        += worstMs;
+            result.worstSwapMaxMs  = juce::jmax (result.worstSwapMaxMs, worstMs);
+        }
+
+        result.meanSwapMaxMs = result.numSwaps > 0 ? totalSwapMaxMs / result.numSwaps : 0.0;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 20.0);
+
+    const double crossfades[] { 0.0, 10.0, 50.0 };
+
+    juce::Array<juce::var> results;
+
+    for (auto crossfadeMs : crossfades)
+    {
+        const auto result = runBenchmark (crossfadeMs, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("crossfadeMs",        crossfadeMs);
+        obj->setProperty ("numSwaps",           result.numSwaps);
+        obj->setProperty ("baselineMaxMs",      result.baselineMaxMs);
+        obj->setProperty ("meanSwapMaxMs",      result.meanSwapMaxMs);
+        obj->setProperty ("worstSwapMaxMs",     result.worstSwapMaxMs);
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("blockPeriodMs",     blockSize * 1000.0 / sampleRate);
+    report.set ("swapIntervalMs",    swapIntervalMs);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
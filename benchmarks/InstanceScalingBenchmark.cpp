@@ -0,0 +1,134 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/ProcessorGroup.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Runs a ParallelProcessorGroup of plugin instances with a growing number of cores
+// (the audio thread plus 0 to instances-1 workers), and prints the per-block cost
+// and the speedup over running every instance on the one thread as JSON.
+//
+// Fails if the group couldn't start every worker it was asked for, as the speedup
+// wouldn't mean anything.
+//
+//  usage: instance_scaling_benchmark [--instances=8] [--seconds=10] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int    blockSize  = 256;
+
+    struct BenchResult
+    {
+        double  meanMicroseconds = 0, p99Microseconds = 0, maxMicroseconds = 0;
+        double  realTimeFactor = 0;
+        int     numWorkersRunning = 0;
+    };
+
+    BenchResult runBenchmark (int numInstances, int numWorkers, double seconds)
+    {
+        std::vector<ParallelProcessorGroup::Chain> chains ((size_t) numInstances);
+
+        for (auto& chain : chains)
+            chain.emplace_back (createPluginFilter());
+
+        ParallelProcessorGroup group (std::move (chains), numWorkers);
+
+        BenchResult result;
+        result.numWorkersRunning = group.getNumWorkers();
+
+        group.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        group.prepareToPlay (sampleRate, blockSize);
+
+        const auto numChannels = juce::jmax (group.getTotalNumInputChannels(), group.getTotalNumOutputChannels());
+        juce::AudioBuffer<float> source (numChannels, blockSize), buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                source.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        const auto numBlocks = juce::jmax (1, juce::roundToInt (seconds * sampleRate / blockSize));
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        // a few blocks first, so the workers have been woken at least once
+        for (int i = -64; i < numBlocks; ++i)
+        {
+            buffer.makeCopyOf (source, true);
+            midi.clear();
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            group.processBlock (buffer, midi);
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+            if (i >= 0)
+                times.push_back (elapsed);
+        }
+
+        group.releaseResources();
+
+        std::sort (times.begin(), times.end());
+        const auto total = std::accumulate (times.begin(), times.end(), 0.0);
+
+        result.meanMicroseconds = total / (double) times.size() * 1.0e6;
+        result.p99Microseconds  = Benchmark::percentile (times, 0.99) * 1.0e6;
+        result.maxMicroseconds  = times.back() * 1.0e6;
+        result.realTimeFactor   = total > 0 ? (numBlocks * blockSize / sampleRate) / total : 0.0;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto numInstances = juce::jmax (1, Benchmark::getOption (args, "--instances", 8));
+    const auto seconds      = Benchmark::getOption (args, "--seconds", 10.0);
+
+    const auto maxCores = juce::jmin (numInstances, juce::SystemStats::getNumCpus());
+
+    juce::Array<juce::var> results;
+    double singleCoreMeanMicroseconds = 0;
+    bool allWorkersRan = true;
+
+    for (int numCores = 1; numCores <= maxCores; ++numCores)
+    {
+        const auto result = runBenchmark (numInstances, numCores - 1, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        if (numCores == 1)
+            singleCoreMeanMicroseconds = result.meanMicroseconds;
+
+        obj->setProperty ("numCores",           numCores);
+        obj->setProperty ("numWorkersRunning",  result.numWorkersRunning);
+        obj->setProperty ("meanMicroseconds",   result.meanMicroseconds);
+        obj->setProperty ("p99Microseconds",    result.p99Microseconds);
+        obj->setProperty ("maxMicroseconds",    result.maxMicroseconds);
+        obj->setProperty ("realTimeFactor",     result.realTimeFactor);
+        obj->setProperty ("speedup",            result.meanMicroseconds > 0 ? singleCoreMeanMicroseconds / result.meanMicroseconds : 0.0);
+
+        // the pool's logged a warning if it couldn't start them all
+        allWorkersRan = allWorkersRan && result.numWorkersRunning == numCores - 1;
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("numInstances",      numInstances);
+    report.set ("numCpus",           juce::SystemStats::getNumCpus());
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("allWorkersRan",     allWorkersRan);
+    report.set ("results",           results);
+
+    return report.write (args, allWorkersRan);
+}
@@ -0,0 +1,156 @@
+#include "../PluginProcessor.h"
+#include "../PluginEditor.h"
+#include "../shared/PluginEditorComponent.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Hosts the plugin's editor in a PluginEditorComponent with the same Grid around it
+// as the standalone app's window, then resizes the editor in bursts (as dragging a
+// corner does) with the message loop let run after each one. Prints how many
+// layout passes and Grid rebuilds that caused, the cost of each resize and each
+// layout pass as JSON, and fails if a burst took more than one pass or the Grid was
+// rebuilt at all. Nothing's put on the desktop, so no display is needed.
+//
+//  usage: layout_benchmark [--bursts=500] [--output=results.json]
+//==============================================================================
+namespace
+{
+    /** Stand-ins for the standalone window's chrome, laid out the same way. */
+    struct Chrome
+    {
+        juce::TextButton            settingsButton { "Settings" }, playButton { "Play" };
+        juce::Label                 meter;
+        juce::Slider                tempoSlider;
+        juce::MidiKeyboardState     keyboardState;
+        juce::MidiKeyboardComponent keyboard { keyboardState, juce::MidiKeyboardComponent::horizontalKeyboard };
+        int                         numGridBuilds = 0;
+
+        juce::Grid build (juce::Component* editor)
+        {
+            using Tr = juce::Grid::TrackInfo;
+            using namespace juce;
+            juce::Grid grid;
+            ++numGridBuilds;
+
+            grid.templateColumns     = { Tr (5_fr), Tr (2_fr), Tr (4_fr), Tr (5_fr) };
+            grid.templateRows        = { Tr (25_px), Tr (1_fr), Tr (60_px) };
+
+            grid.templateAreas       = { "HeaderOne Transport Meter HeaderTwo",
+                                         "Main Main Main Main",
+                                         "Footer Footer Footer Footer" };
+
+            grid.items = { juce::GridItem (settingsButton).withArea ("HeaderOne"),
+                           juce::GridItem (playButton).withArea ("Transport"),
+                           juce::GridItem (meter).withArea ("Meter"),
+                           juce::GridItem (tempoSlider).withArea ("HeaderTwo"),
+                           juce::GridItem (editor).withArea ("Main"),
+                           juce::GridItem (keyboard).withArea ("Footer") };
+            return grid;
+        }
+    };
+
+    struct BenchResult
+    {
+        int     numResizes = 0, numLayoutPasses = 0, numGridBuilds = 0;
+        double  meanResizeMicroseconds = 0, meanLayoutMs = 0, maxLayoutMs = 0;
+    };
+
+    BenchResult runBenchmark (int resizesPerBurst, int numBursts)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        Chrome chrome;
+
+        PluginEditorComponent holder (std::unique_ptr<juce::AudioProcessorEditor> (proc->createEditor()),
+                                      [&chrome] (juce::Component* editor) { return chrome.build (editor); });
+
+        auto* editor = holder.getChildComponent (0);
+        const auto initialBounds = editor->getBounds();
+
+        // the constructor's own build and pass don't count
+        const auto gridBuildsBefore   = chrome.numGridBuilds;
+        const auto layoutPassesBefore = holder.getNumLayoutPasses();
+
+        std::vector<double> resizeTimes, layoutTimesMs;
+        int step = 0;
+
+        for (int burst = 0; burst < numBursts; ++burst)
+        {
+            const auto passesBefore = holder.getNumLayoutPasses();
+
+            for (int i = 0; i < resizesPerBurst; ++i)
+            {
+                // a drag outwards over a few hundred pixels, then back to the start
+                const auto offset = ++step % 300;
+
+                const auto start = juce::Time::getHighResolutionTicks();
+                editor->setSize (initialBounds.getWidth() + offset, initialBounds.getHeight() + offset / 2);
+                resizeTimes.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+            }
+
+            // the next frame, as far as the layout's concerned
+            for (int tries = 0; tries < 100 && holder.getNumLayoutPasses() == passesBefore; ++tries)
+                juce::MessageManager::getInstance()->runDispatchLoopUntil (1);
+
+            if (holder.getNumLayoutPasses() != passesBefore)
+                layoutTimesMs.push_back (holder.getLastLayoutTimeMs());
+        }
+
+        BenchResult result;
+        result.numResizes       = (int) resizeTimes.size();
+        result.numLayoutPasses  = holder.getNumLayoutPasses() - layoutPassesBefore;
+        result.numGridBuilds    = chrome.numGridBuilds - gridBuildsBefore;
+        result.meanResizeMicroseconds = std::accumulate (resizeTimes.begin(), resizeTimes.end(), 0.0) / (double) resizeTimes.size() * 1.0e6;
+
+        if (! layoutTimesMs.empty())
+        {
+            result.meanLayoutMs = std::accumulate (layoutTimesMs.begin(), layoutTimesMs.end(), 0.0) / (double) layoutTimesMs.size();
+            result.maxLayoutMs  = *std::max_element (layoutTimesMs.begin(), layoutTimesMs.end());
+        }
+
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // sets up the message manager and fonts, but never touches the windowing system
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto numBursts = juce::jmax (1, Benchmark::getOption (args, "--bursts", 500));
+
+    const int resizesPerBurst[] { 1, 4, 16 };
+
+    juce::Array<juce::var> results;
+    bool onePassPerBurst = true;
+
+    for (auto resizes : resizesPerBurst)
+    {
+        const auto result = runBenchmark (resizes, numBursts);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("resizesPerBurst",        resizes);
+        obj->setProperty ("numResizes",             result.numResizes);
+        obj->setProperty ("numLayoutPasses",        result.numLayoutPasses);
+        obj->setProperty ("numGridBuilds",          result.numGridBuilds);
+        obj->setProperty ("meanResizeMicroseconds", result.meanResizeMicroseconds);
+        obj->setProperty ("meanLayoutMs",           result.meanLayoutMs);
+        obj->setProperty ("maxLayoutMs",            result.maxLayoutMs);
+
+        onePassPerBurst = onePassPerBurst && result.numLayoutPasses == numBursts && result.numGridBuilds == 0;
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("burstsPerConfig",  numBursts);
+    report.set ("onePassPerBurst",  onePassPerBurst);
+    report.set ("results",          results);
+
+    return report.write (args, onePassPerBurst);
+}
@@ -0,0 +1,191 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin through AudioTransportPlayer a block at a time, paced to real
+// time like a device would drive it, while another thread feeds it timestamped notes
+// through handleIncomingMidiMessage() just as a MIDI input would. The plugin passes
+// its MIDI straight through, so each note's position in the block it lands in shows
+// when it would be heard. Prints the latency from each note's timestamp to that
+// point (and how much it varies) at a few block sizes as JSON.
+//
+// Notes should arrive in order with none lost, about a block period late, and with
+// only as much jitter as the blocks themselves are rendered with.
+//
+//  usage: midi_latency_benchmark [--seconds=10] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    numChannels = 2;
+
+    double nowSeconds()         { return juce::Time::getMillisecondCounterHiRes() * 0.001; }
+
+    /** Renders numBlocks blocks, noting when each note it gets back would be heard. */
+    struct RenderThread  : public juce::Thread
+    {
+        RenderThread (AudioTransportPlayer& playerIn, int blockSizeIn, int numBlocksIn)
+            : juce::Thread ("MIDI Latency Render"), player (playerIn), blockSize (blockSizeIn), numBlocks (numBlocksIn)
+        {
+        }
+
+        void run() override
+        {
+            player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+            ready.signal();
+
+            juce::AudioBuffer<float> input (numChannels, blockSize), output (numChannels, blockSize);
+            juce::MidiBuffer midiOut;
+            input.clear();
+
+            const auto start = nowSeconds();
+
+            for (int i = 0; i < numBlocks && ! threadShouldExit(); ++i)
+            {
+                // wait until the block would be due, as if a device were asking for it
+                const auto due = start + (i * blockSize) / sampleRate;
+
+                if (due > nowSeconds())
+                    juce::Time::waitForMillisecondCounter ((juce::uint32) (due * 1000.0));
+
+                const auto blockTime = nowSeconds();
+                lastBlockTime = blockTime;
+
+                midiOut.clear();
+                player.renderOffline (&input, output, 0, blockSize, nullptr, &midiOut);
+
+                for (const auto metadata : midiOut)
+                {
+                    const auto message = metadata.getMessage();
+
+                    if (message.isNoteOn())
+                        landed.push_back ({ message.getNoteNumber(), blockTime + metadata.samplePosition / sampleRate });
+                }
+            }
+
+            player.releaseOfflineRender();
+        }
+
+        struct Landed
+        {
+            int     noteNumber;
+            double  heardAt;
+        };
+
+        AudioTransportPlayer&   player;
+        const int               blockSize, numBlocks;
+        std::vector<Landed>     landed;
+        double                  lastBlockTime = 0;
+        juce::WaitableEvent     ready;
+    };
+
+    struct BenchResult
+    {
+        int     numSent = 0, numDue = 0, numLanded = 0;
+        bool    inOrder = true;
+        double  meanLatencyMs = 0, minLatencyMs = 0, maxLatencyMs = 0, p99JitterMs = 0;
+    };
+
+    BenchResult runBenchmark (int blockSize, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+        player.setProcessor (proc.get());
+
+        RenderThread renderer (player, blockSize, juce::roundToInt (seconds * sampleRate / blockSize));
+        renderer.startThread (juce::Thread::Priority::highest);
+        renderer.ready.wait (-1);
+
+        // sent from here as if this were the MIDI input thread, a note every few ms
+        std::vector<double> sentAt;
+        juce::Random random (0x5eed);
+
+        while (renderer.isThreadRunning())
+        {
+            auto message = juce::MidiMessage::noteOn (1, (int) (sentAt.size() % 128), 1.0f);
+            message.setTimeStamp (nowSeconds());
+
+            sentAt.push_back (message.getTimeStamp());
+            player.handleIncomingMidiMessage (nullptr, message);
+
+            juce::Thread::sleep (1 + random.nextInt (4));
+        }
+
+        renderer.waitForThreadToExit (-1);
+        player.setProcessor (nullptr);
+
+        BenchResult result;
+        result.numSent   = (int) sentAt.size();
+        result.numLanded = (int) renderer.landed.size();
+
+        // anything sent after the final block started had nowhere to land
+        result.numDue = (int) std::count_if (sentAt.begin(), sentAt.end(),
+                                             [&] (double t) { return t < renderer.lastBlockTime; });
+        std::vector<double> latencies;
+
+        for (size_t i = 0; i < renderer.landed.size() && i < sentAt.size(); ++i)
+        {
+            result.inOrder = result.inOrder && renderer.landed[i].noteNumber == (int) (i % 128);
+            latencies.push_back ((renderer.landed[i].heardAt - sentAt[i]) * 1000.0);
+        }
+
+        if (latencies.empty())
+            return result;
+
+        result.meanLatencyMs = std::accumulate (latencies.begin(), latencies.end(), 0.0) / (double) latencies.size();
+
+        std::sort (latencies.begin(), latencies.end());
+        result.minLatencyMs = latencies.front();
+        result.maxLatencyMs = latencies.back();
+        result.p99JitterMs  = Benchmark::percentile (latencies, 0.99) - Benchmark::percentile (latencies, 0.01);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 10.0);
+
+    const int blockSizes[] { 64, 256, 1024 };
+
+    juce::Array<juce::var> results;
+    bool noneLost = true;
+
+    for (auto blockSize : blockSizes)
+    {
+        const auto result = runBenchmark (blockSize, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("blockSize",          blockSize);
+        obj->setProperty ("blockPeriodMs",      blockSize * 1000.0 / sampleRate);
+        obj->setProperty ("numSent",            result.numSent);
+        obj->setProperty ("numDue",             result.numDue);
+        obj->setProperty ("numLanded",          result.numLanded);
+        obj->setProperty ("inOrder",            result.inOrder);
+        obj->setProperty ("meanLatencyMs",      result.meanLatencyMs);
+        obj->setProperty ("minLatencyMs",       result.minLatencyMs);
+        obj->setProperty ("maxLatencyMs",       result.maxLatencyMs);
+        obj->setProperty ("p99JitterMs",        result.p99JitterMs);
+
+        noneLost = noneLost && result.inOrder && result.numLanded > 0 && result.numLanded >= result.numDue;
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("noneLost",          noneLost);
+    report.set ("results",           results);
+
+    return report.write (args, noneLost);
+}
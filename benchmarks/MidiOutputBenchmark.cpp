@@ -0,0 +1,140 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin through AudioTransportPlayer a block at a time, paced to real
+// time like a device would drive it, with no MIDI and with more and more notes per
+// block going through it (the plugin passes its MIDI straight through, so they all
+// come out as MIDI output). Each is run with no MIDI output and with a virtual MIDI
+// output device connected, and the per-block cost is printed as JSON.
+//
+// The output's written to from the player's sender thread, so the block cost should
+// hardly change when one's connected, however much MIDI's being sent.
+//
+// Where virtual MIDI devices aren't available (e.g. Windows, or Linux without ALSA),
+// only the runs without an output are made.
+//
+//  usage: midi_output_benchmark [--seconds=10] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    blockSize   = 256;
+    constexpr int    numChannels = 2;
+
+    struct BenchResult
+    {
+        double  meanMicroseconds = 0, p99Microseconds = 0, maxMicroseconds = 0;
+    };
+
+    BenchResult runBenchmark (juce::MidiOutput* midiOutput, int notesPerBlock, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.setMidiOutput (midiOutput);
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> input (numChannels, blockSize), output (numChannels, blockSize);
+        input.clear();
+
+        // spread evenly over the block, alternating on and off so nothing's left hanging
+        juce::MidiBuffer midi;
+
+        for (int i = 0; i < notesPerBlock; ++i)
+        {
+            const auto note = 36 + (i / 2) % 48;
+            midi.addEvent ((i & 1) == 0 ? juce::MidiMessage::noteOn (1, note, 0.8f)
+                                        : juce::MidiMessage::noteOff (1, note), i * blockSize / notesPerBlock);
+        }
+
+        const auto numBlocks = juce::jmax (1, juce::roundToInt (seconds * sampleRate / blockSize));
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            // wait until the block would be due, as if a device were asking for it
+            const auto due = start + (i * blockSize) * 1000.0 / sampleRate;
+
+            if (due > juce::Time::getMillisecondCounterHiRes())
+                juce::Time::waitForMillisecondCounter ((juce::uint32) due);
+
+            const auto before = juce::Time::getHighResolutionTicks();
+            player.renderOffline (&input, output, 0, blockSize, &midi);
+            times.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - before));
+        }
+
+        player.releaseOfflineRender();
+        player.setMidiOutput (nullptr);
+        player.setProcessor (nullptr);
+
+        std::sort (times.begin(), times.end());
+
+        BenchResult result;
+        result.meanMicroseconds = std::accumulate (times.begin(), times.end(), 0.0) / (double) times.size() * 1.0e6;
+        result.p99Microseconds  = Benchmark::percentile (times, 0.99) * 1.0e6;
+        result.maxMicroseconds  = times.back() * 1.0e6;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 10.0);
+
+    const int notesPerBlock[] { 0, 16, 128 };
+
+   #if JUCE_LINUX || JUCE_MAC
+    const auto virtualOutput = juce::MidiOutput::createNewDevice ("MIDI Output Benchmark");
+   #else
+    const std::unique_ptr<juce::MidiOutput> virtualOutput;
+   #endif
+
+    std::vector<juce::MidiOutput*> outputs { nullptr };
+
+    if (virtualOutput != nullptr)
+        outputs.push_back (virtualOutput.get());
+
+    juce::Array<juce::var> results;
+
+    for (auto* midiOutput : outputs)
+    {
+        for (auto notes : notesPerBlock)
+        {
+            const auto result = runBenchmark (midiOutput, notes, seconds);
+            auto* obj = new juce::DynamicObject();
+
+            obj->setProperty ("midiOutput",         midiOutput != nullptr);
+            obj->setProperty ("notesPerBlock",      notes);
+            obj->setProperty ("meanMicroseconds",   result.meanMicroseconds);
+            obj->setProperty ("p99Microseconds",    result.p99Microseconds);
+            obj->setProperty ("maxMicroseconds",    result.maxMicroseconds);
+
+            results.add (juce::var (obj));
+        }
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("blockPeriodMs",     blockSize * 1000.0 / sampleRate);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("virtualMidiOutput", virtualOutput != nullptr);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
@@ -0,0 +1,128 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "../shared/standalone/VirtualAudioDevice.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin through AudioTransportPlayer as fast as the CPU allows, at a
+// few block sizes, two ways: with renderOffline(), and by calling the device
+// callback in a loop (set up by a VirtualAudioIODevice that's opened but never
+// started, so nothing paces it). Prints the throughput of each as JSON, so the
+// offline path's overhead against the realtime one shows up.
+//
+//  usage: offline_render_benchmark [--seconds=60] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    numChannels = 2;
+
+    /** Seconds of audio rendered per second of wall time. */
+    double renderOffline (int blockSize, int numSamples)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> output (numChannels, numSamples);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        player.renderOffline (nullptr, output, 0, numSamples);
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+
+        return elapsed > 0 ? (numSamples / sampleRate) / elapsed : 0.0;
+    }
+
+    double renderThroughDeviceCallback (int blockSize, int numSamples)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        VirtualAudioIODevice::Settings settings;
+        settings.sampleRate        = sampleRate;
+        settings.bufferSize        = blockSize;
+        settings.numInputChannels  = numChannels;
+        settings.numOutputChannels = numChannels;
+
+        juce::BigInteger channels;
+        channels.setRange (0, numChannels, true);
+
+        VirtualAudioIODevice device ("Offline Render Benchmark", "Virtual", settings);
+        device.open (channels, channels, sampleRate, blockSize);
+
+        player.setProcessor (proc.get());
+        player.audioDeviceAboutToStart (&device);
+
+        juce::AudioBuffer<float> input (numChannels, blockSize), output (numChannels, blockSize);
+        input.clear();
+
+        const auto numBlocks = numSamples / blockSize;
+        const auto periodNs  = (juce::uint64) (blockSize * 1.0e9 / sampleRate);
+        juce::uint64 hostTimeNs = 0;
+
+        juce::AudioIODeviceCallbackContext context;
+        context.hostTimeNs = &hostTimeNs;
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            player.audioDeviceIOCallbackWithContext (input.getArrayOfReadPointers(), numChannels,
+                                                     output.getArrayOfWritePointers(), numChannels,
+                                                     blockSize, context);
+            hostTimeNs += periodNs;
+        }
+
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        player.audioDeviceStopped();
+        player.setProcessor (nullptr);
+        device.close();
+
+        return elapsed > 0 ? (numBlocks * blockSize / sampleRate) / elapsed : 0.0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds    = Benchmark::getOption (args, "--seconds", 60.0);
+    const auto numSamples = juce::roundToInt (seconds * sampleRate);
+
+    const int blockSizes[] { 64, 256, 1024, 4096 };
+
+    juce::Array<juce::var> results;
+
+    for (auto blockSize : blockSizes)
+    {
+        const auto offline  = renderOffline (blockSize, numSamples);
+        const auto realtime = renderThroughDeviceCallback (blockSize, numSamples);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("blockSize",              blockSize);
+        obj->setProperty ("offlineRealTimeFactor",  offline);
+        obj->setProperty ("deviceRealTimeFactor",   realtime);
+        obj->setProperty ("offlineOverheadPercent", offline > 0 ? (realtime / offline - 1.0) * 100.0 : 0.0);
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
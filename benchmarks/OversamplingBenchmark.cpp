@@ -0,0 +1,155 @@
+#include "../PluginProcessor.h"
+#include "BenchmarkCommon.h"
+
+//==============================================================================
+// Runs PluginProcessor::processBlock with its oversampling stage at each factor,
+// with both kinds of half-band filter, and prints the throughput (and overhead
+// against no oversampling) and reported latency as JSON. Each config also checks
+// that a host block bigger than the one the plugin was prepared for comes out the
+// same as it would have in prepared-size blocks.
+//
+//  usage: oversampling_benchmark [--seconds=30] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    blockSize   = 512;
+    constexpr int    numChannels = 2;
+
+    struct BenchResult
+    {
+        double  realTimeFactor = 0;
+        int     latencySamples = 0;
+        bool    oversizedBlockMatches = false;
+    };
+
+    /** Runs the same noise through two instances, one as a single block of a few times
+        the prepared size and one in prepared-size blocks.
+    */
+    bool checkOversizedBlock (int factor, Oversampler::FilterType type)
+    {
+        const auto numSamples = blockSize * 3 + 17;
+        juce::AudioBuffer<float> whole (numChannels, numSamples);
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < numSamples; ++i)
+                whole.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        auto pieces = whole;
+        juce::MidiBuffer midi;
+
+        PluginProcessor procs[2];
+
+        for (auto& proc : procs)
+        {
+            proc.setOversampling (factor, factor, type);
+            proc.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            proc.prepareToPlay (sampleRate, blockSize);
+        }
+
+        procs[0].processBlock (whole, midi);
+
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            juce::AudioBuffer<float> piece (pieces.getArrayOfWritePointers(), numChannels,
+                                            start, juce::jmin (blockSize, numSamples - start));
+            procs[1].processBlock (piece, midi);
+        }
+
+        for (auto& proc : procs)
+            proc.releaseResources();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < numSamples; ++i)
+                if (whole.getSample (ch, i) != pieces.getSample (ch, i))
+                    return false;
+
+        return true;
+    }
+
+    BenchResult runBenchmark (int factor, Oversampler::FilterType type, double seconds)
+    {
+        PluginProcessor proc;
+        proc.setOversampling (factor, factor, type);
+        proc.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        proc.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> source (numChannels, blockSize), buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                source.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        const auto numBlocks = juce::roundToInt (seconds * sampleRate / blockSize);
+        auto elapsed = 0.0;
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            buffer.makeCopyOf (source, true);
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            proc.processBlock (buffer, midi);
+            elapsed += juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        proc.releaseResources();
+
+        BenchResult result;
+        result.realTimeFactor = elapsed > 0 ? (numBlocks * blockSize / sampleRate) / elapsed : 0.0;
+        result.latencySamples = proc.getLatencySamples();
+        result.oversizedBlockMatches = checkOversizedBlock (factor, type);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 30.0);
+
+    const std::pair<Oversampler::FilterType, const char*> filterTypes[] { { Oversampler::FilterType::firHalfBand, "fir" },
+                                                                          { Oversampler::FilterType::iirHalfBand, "iir" } };
+    const int factors[] { 2, 4, 8 };
+
+    juce::Array<juce::var> results;
+    bool allOversizedBlocksMatch = true;
+
+    for (const auto& [type, name] : filterTypes)
+    {
+        const auto baseline = runBenchmark (1, type, seconds);
+
+        for (auto factor : factors)
+        {
+            const auto result = runBenchmark (factor, type, seconds);
+            auto* obj = new juce::DynamicObject();
+
+            obj->setProperty ("filter",             name);
+            obj->setProperty ("factor",             factor);
+            obj->setProperty ("realTimeFactor",     result.realTimeFactor);
+            obj->setProperty ("overheadPercent",    result.realTimeFactor > 0 ? (baseline.realTimeFactor / result.realTimeFactor - 1.0) * 100.0 : 0.0);
+            obj->setProperty ("latencySamples",     result.latencySamples);
+            obj->setProperty ("oversizedBlockMatches", result.oversizedBlockMatches);
+
+            allOversizedBlocksMatch = allOversizedBlocksMatch && result.oversizedBlockMatches;
+
+            results.add (juce::var (obj));
+        }
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("numChannels",       numChannels);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("allOversizedBlocksMatch", allOversizedBlocksMatch);
+    report.set ("results",           results);
+
+    return report.write (args, allOversizedBlocksMatch);
+}
@@ -0,0 +1,131 @@
+#include "../PluginProcessor.h"
+#include "../PluginEditor.h"
+#include "../shared/PluginEditorComponent.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Paints the plugin's editor into an Image at 1x, 1.5x and 2x, with and without
+// PluginEditorComponent's raster cache, and prints per-frame timings as JSON.
+// Everything's rendered with the software renderer into off-screen images, so
+// nothing is ever put on the desktop and no display is needed.
+//
+//  usage: paint_benchmark [--frames=500] [--output=results.json]
+//
+//  - uncached:       every frame paints the editor from scratch
+//  - cached, clean:  the editor hasn't repainted itself since the last frame
+//  - cached, dirty:  the editor repaints itself every frame (the cache's worst case)
+//==============================================================================
+namespace
+{
+    enum class Mode { uncached, cachedClean, cachedDirty };
+
+    const char* getModeName (Mode mode)
+    {
+        switch (mode)
+        {
+            case Mode::uncached:    return "uncached";
+            case Mode::cachedClean: return "cachedClean";
+            case Mode::cachedDirty: return "cachedDirty";
+        }
+
+        return "";
+    }
+
+    struct BenchResult
+    {
+        int     numFrames = 0, numRasterisations = 0;
+        double  meanSeconds = 0, p99Seconds = 0, maxSeconds = 0;
+    };
+
+    BenchResult runBenchmark (float scale, Mode mode, int numFrames)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        PluginEditorComponent holder (std::unique_ptr<juce::AudioProcessorEditor> (proc->createEditor()));
+        holder.setRasterCacheEnabled (mode != Mode::uncached);
+
+        auto* editor = holder.getChildComponent (0);
+        const auto imageBounds = holder.getLocalBounds() * scale;
+
+        juce::Image image (juce::Image::RGB, imageBounds.getWidth(), imageBounds.getHeight(), true,
+                           juce::SoftwareImageType());
+
+        std::vector<double> times;
+        times.reserve ((size_t) numFrames);
+
+        // the first frame fills the cache, so a few are left out of the timings
+        const auto numWarmUpFrames = juce::jmin (numFrames, 8);
+
+        for (int i = -numWarmUpFrames; i < numFrames; ++i)
+        {
+            if (mode == Mode::cachedDirty)
+                editor->repaint();
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            {
+                juce::Graphics g (image);
+                g.addTransform (juce::AffineTransform::scale (scale));
+                holder.paintEntireComponent (g, true);
+            }
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            if (i >= 0)
+                times.push_back (juce::Time::highResolutionTicksToSeconds (end - start));
+        }
+
+        std::sort (times.begin(), times.end());
+
+        BenchResult result;
+        result.numFrames         = (int) times.size();
+        result.numRasterisations = holder.getRasterCache() != nullptr ? holder.getRasterCache()->getNumRasterisations()
+                                                                      : numWarmUpFrames + numFrames;
+        result.meanSeconds       = std::accumulate (times.begin(), times.end(), 0.0) / (double) times.size();
+        result.p99Seconds        = Benchmark::percentile (times, 0.99);
+        result.maxSeconds        = times.back();
+        return result;
+    }
+
+    juce::var toVar (float scale, Mode mode, const BenchResult& result)
+    {
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("scale",              scale);
+        obj->setProperty ("mode",               getModeName (mode));
+        obj->setProperty ("numFrames",          result.numFrames);
+        obj->setProperty ("numRasterisations",  result.numRasterisations);
+        obj->setProperty ("meanMicroseconds",   result.meanSeconds * 1.0e6);
+        obj->setProperty ("p99Microseconds",    result.p99Seconds  * 1.0e6);
+        obj->setProperty ("maxMicroseconds",    result.maxSeconds  * 1.0e6);
+
+        return juce::var (obj);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // sets up the message manager and fonts, but never touches the windowing system
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto numFrames = juce::jmax (1, Benchmark::getOption (args, "--frames", 500));
+
+    const float scales[] { 1.0f, 1.5f, 2.0f };
+    const Mode  modes[]  { Mode::uncached, Mode::cachedClean, Mode::cachedDirty };
+
+    juce::Array<juce::var> results;
+
+    for (auto scale : scales)
+        for (auto mode : modes)
+            results.add (toVar (scale, mode, runBenchmark (scale, mode, numFrames)));
+
+    Benchmark::Report report;
+
+    report.set ("framesPerConfig",  numFrames);
+    report.set ("results",          results);
+
+    return report.write (args);
+}
@@ -0,0 +1,140 @@
+#include "../ProcessorParameters.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+//==============================================================================
+// Measures the per-block cost of ParameterStore::beginBlock with 10, 100 and 1000
+// parameters, against the usual one SmoothedValue per parameter, sample by sample
+// approach, and prints the timings as JSON.
+//
+//  usage: parameter_benchmark [--blocks=20000] [--output=results.json]
+//
+// Each config moves a different proportion of the parameters every block - none,
+// a tenth, or all of them - so the cost of the ones that sit still shows up too.
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int    blockSize  = 512;
+
+    struct BenchResult
+    {
+        double  storeMeanSeconds = 0, smoothedValueMeanSeconds = 0;
+    };
+
+    // somewhere for the results to go, so the work isn't optimised away
+    volatile float sink = 0.0f;
+
+    template <typename Fn>
+    double meanBlockSeconds (int numBlocks, Fn&& processBlock)
+    {
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            processBlock (block);
+            times.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+        }
+
+        return std::accumulate (times.begin(), times.end(), 0.0) / (double) times.size();
+    }
+
+    // every `stride`th parameter gets a new value every block (stride 0 means none do)
+    float nextValue (int block, int index)      { return (float) ((block + index) % 7) / 7.0f; }
+
+    BenchResult runBenchmark (int numParams, int stride, int numBlocks)
+    {
+        BenchResult result;
+        float total = 0.0f;
+
+        {
+            ParameterStore store;
+
+            for (int i = 0; i < numParams; ++i)
+                store.addParameter (0.0f);
+
+            store.prepare (sampleRate, blockSize);
+
+            result.storeMeanSeconds = meanBlockSeconds (numBlocks, [&] (int block)
+            {
+                if (stride > 0)
+                    for (int i = 0; i < numParams; i += stride)
+                        store.set (i, nextValue (block, i));
+
+                store.beginBlock (blockSize);
+
+                // read the values back, like a processor would
+                for (int i = 0; i < numParams; ++i)
+                    total += store.getRamp (i) != nullptr ? store.getRamp (i)[blockSize - 1] : store.getValue (i);
+            });
+        }
+
+        {
+            std::vector<juce::SmoothedValue<float>> values ((size_t) numParams);
+            juce::AudioBuffer<float> ramps (numParams, blockSize);
+
+            for (auto& v : values)
+                v.reset (sampleRate, 0.02);
+
+            result.smoothedValueMeanSeconds = meanBlockSeconds (numBlocks, [&] (int block)
+            {
+                if (stride > 0)
+                    for (int i = 0; i < numParams; i += stride)
+                        values[(size_t) i].setTargetValue (nextValue (block, i));
+
+                for (int i = 0; i < numParams; ++i)
+                {
+                    auto* dest = ramps.getWritePointer (i);
+
+                    for (int s = 0; s < blockSize; ++s)
+                        dest[s] = values[(size_t) i].getNextValue();
+
+                    total += dest[blockSize - 1];
+                }
+            });
+        }
+
+        sink = total;
+        return result;
+    }
+
+    juce::var toVar (int numParams, int stride, const BenchResult& result)
+    {
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("numParameters",                  numParams);
+        obj->setProperty ("proportionChangedPerBlock",      stride > 0 ? 1.0 / stride : 0.0);
+        obj->setProperty ("storeMeanMicroseconds",          result.storeMeanSeconds * 1.0e6);
+        obj->setProperty ("smoothedValueMeanMicroseconds",  result.smoothedValueMeanSeconds * 1.0e6);
+
+        return juce::var (obj);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+
+    const auto numBlocks = juce::jmax (1, Benchmark::getOption (args, "--blocks", 20000));
+
+    const int parameterCounts[] { 10, 100, 1000 };
+    const int strides[]         { 0, 10, 1 };
+
+    juce::Array<juce::var> results;
+
+    for (auto numParams : parameterCounts)
+        for (auto stride : strides)
+            results.add (toVar (numParams, stride, runBenchmark (numParams, stride, numBlocks)));
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",       sampleRate);
+    report.set ("blockSize",        blockSize);
+    report.set ("blocksPerConfig",  numBlocks);
+    report.set ("results",          results);
+
+    return report.write (args);
+}
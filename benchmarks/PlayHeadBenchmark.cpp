@@ -0,0 +1,144 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+//==============================================================================
+// Runs AudioTransportPlayer's PlayHead through hours of blocks, with and without a
+// loop and with the tempo held, changed every few seconds, or changed every block,
+// and checks the position it reports at the start of each block against a reference
+// timeline worked out from scratch in long double. Prints the worst error (in
+// quarter notes) and the error at the end of each run as JSON, and fails if any of
+// them drifted.
+//
+// Without a loop, timeInSamples has to match the number of samples rendered exactly.
+//
+//  usage: play_head_benchmark [--hours=4] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate     = 44100.0;
+    constexpr int    blockSize      = 512;
+    constexpr double loopLength     = 16.0;     // the PlayHead's default loop, from 0
+    constexpr double maxErrorPpq    = 1.0e-6;   // well under a hundredth of a sample at any tempo used here
+
+    struct BenchConfig
+    {
+        bool            looping = false;
+        int             blocksPerTempoChange = 0;   // 0 to keep the tempo as it is
+        const char*     name = "";
+    };
+
+    struct BenchResult
+    {
+        juce::int64 numBlocks = 0, numLoops = 0;
+        double      maxErrorPpq = 0, finalErrorPpq = 0, secondsTaken = 0;
+        bool        timeInSamplesMatches = true;
+    };
+
+    BenchResult runBenchmark (const BenchConfig& config, double hours)
+    {
+        AudioTransportPlayer::PlayHead playHead;
+        playHead.setLooping (config.looping);
+
+        juce::Random random (0x5eed);
+        auto bpm = 120.0;
+
+        // the reference only ever multiplies from where the tempo last changed, so it
+        // can't drift however many blocks it runs for
+        long double segmentStartPpq = 0, unwrappedPpq = 0;
+        juce::int64 segmentSamples = 0;
+
+        BenchResult result;
+        result.numBlocks = (juce::int64) (hours * 3600.0 * sampleRate / blockSize);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (juce::int64 block = 0; block < result.numBlocks; ++block)
+        {
+            if (config.blocksPerTempoChange > 0 && block > 0 && block % config.blocksPerTempoChange == 0)
+            {
+                segmentStartPpq = unwrappedPpq;
+                segmentSamples  = 0;
+                bpm = 60.0 + random.nextDouble() * 140.0;
+                playHead.setBpm (bpm);
+            }
+
+            playHead.advance (juce::nullopt, blockSize, sampleRate);
+
+            const auto reported = *playHead.info.getPpqPosition();
+            auto expected = (double) unwrappedPpq;
+            auto error    = std::abs (reported - expected);
+
+            if (config.looping)
+            {
+                // either side of the loop end is as good as the other
+                expected = (double) std::fmod (unwrappedPpq, (long double) loopLength);
+                error    = std::abs (reported - expected);
+                error    = juce::jmin (error, loopLength - error);
+            }
+            else if (playHead.info.getTimeInSamples().orFallback (-1) != block * blockSize)
+            {
+                result.timeInSamplesMatches = false;
+            }
+
+            result.maxErrorPpq   = juce::jmax (result.maxErrorPpq, error);
+            result.finalErrorPpq = error;
+
+            segmentSamples += blockSize;
+            unwrappedPpq    = segmentStartPpq + (long double) segmentSamples * (long double) bpm / (60.0L * (long double) sampleRate);
+        }
+
+        result.secondsTaken = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        result.numLoops     = config.looping ? (juce::int64) (unwrappedPpq / (long double) loopLength) : 0;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto hours = Benchmark::getOption (args, "--hours", 4.0);
+
+    const auto blocksPerFiveSeconds = juce::roundToInt (5.0 * sampleRate / blockSize);
+
+    const BenchConfig configs[] { { false, 0,                    "steady" },
+                                  { false, blocksPerFiveSeconds, "tempo changes" },
+                                  { false, 1,                    "tempo change every block" },
+                                  { true,  0,                    "looping" },
+                                  { true,  blocksPerFiveSeconds, "looping with tempo changes" },
+                                  { true,  1,                    "looping with a tempo change every block" } };
+
+    juce::Array<juce::var> results;
+    bool noDrift = true;
+
+    for (const auto& config : configs)
+    {
+        const auto result = runBenchmark (config, hours);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("config",             config.name);
+        obj->setProperty ("numBlocks",          result.numBlocks);
+        obj->setProperty ("numLoops",           result.numLoops);
+        obj->setProperty ("maxErrorPpq",        result.maxErrorPpq);
+        obj->setProperty ("finalErrorPpq",      result.finalErrorPpq);
+        obj->setProperty ("timeInSamplesMatches", result.timeInSamplesMatches);
+        obj->setProperty ("secondsTaken",       result.secondsTaken);
+
+        noDrift = noDrift && result.maxErrorPpq <= maxErrorPpq && result.timeInSamplesMatches;
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("hoursPerConfig",    hours);
+    report.set ("maxErrorPpq",       maxErrorPpq);
+    report.set ("noDrift",           noDrift);
+    report.set ("results",           results);
+
+    return report.write (args, noDrift);
+}
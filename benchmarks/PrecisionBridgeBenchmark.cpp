@@ -0,0 +1,160 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+//==============================================================================
+// Renders a processor that can run in either precision through AudioTransportPlayer
+// with renderOffline(), once in single precision and once through the player's
+// double precision bridge, at a few block sizes, and prints the per-block cost of
+// each (and the bridge's overhead) as JSON. Each run also checks the audio comes
+// back out of the bridge as it should.
+//
+// The plugin itself doesn't do double precision, so this uses a plain gain stage,
+// which keeps the processing small next to the conversion being measured.
+//
+//  usage: precision_bridge_benchmark [--seconds=10] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    numChannels = 2;
+    constexpr float  gain        = 0.5f;
+
+    /** Halves its input, in whichever precision it's been asked to run in. */
+    class GainProcessor  : public juce::AudioProcessor
+    {
+    public:
+        GainProcessor()
+            : juce::AudioProcessor (BusesProperties().withInput  ("Input",  juce::AudioChannelSet::stereo())
+                                                     .withOutput ("Output", juce::AudioChannelSet::stereo()))
+        {
+        }
+
+        const juce::String getName() const override                         { return "Gain"; }
+        void prepareToPlay (double, int) override                           {}
+        void releaseResources() override                                    {}
+        bool supportsDoublePrecisionProcessing() const override             { return true; }
+
+        void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+        {
+            buffer.applyGain (gain);
+            ++numFloatBlocks;
+        }
+
+        void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer&) override
+        {
+            buffer.applyGain ((double) gain);
+            ++numDoubleBlocks;
+        }
+
+        double getTailLengthSeconds() const override                        { return 0.0; }
+        bool acceptsMidi() const override                                   { return false; }
+        bool producesMidi() const override                                  { return false; }
+        juce::AudioProcessorEditor* createEditor() override                 { return nullptr; }
+        bool hasEditor() const override                                     { return false; }
+        int getNumPrograms() override                                       { return 1; }
+        int getCurrentProgram() override                                    { return 0; }
+        void setCurrentProgram (int) override                               {}
+        const juce::String getProgramName (int) override                    { return {}; }
+        void changeProgramName (int, const juce::String&) override          {}
+        void getStateInformation (juce::MemoryBlock&) override              {}
+        void setStateInformation (const void*, int) override                {}
+
+        int numFloatBlocks = 0, numDoubleBlocks = 0;
+    };
+
+    struct BenchResult
+    {
+        double  meanMicroseconds = 0, p99Microseconds = 0;
+        bool    ranInRightPrecision = false, outputMatches = false;
+    };
+
+    BenchResult runBenchmark (int blockSize, bool doublePrecision, double seconds)
+    {
+        GainProcessor proc;
+        AudioTransportPlayer player (doublePrecision);
+
+        player.setProcessor (&proc);
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> input (numChannels, blockSize), output (numChannels, blockSize);
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                input.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        const auto numBlocks = juce::jmax (1, juce::roundToInt (seconds * sampleRate / blockSize));
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            player.renderOffline (&input, output, 0, blockSize);
+            times.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+        }
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+
+        BenchResult result;
+        result.ranInRightPrecision = doublePrecision ? (proc.numDoubleBlocks == numBlocks && proc.numFloatBlocks == 0)
+                                                     : (proc.numFloatBlocks == numBlocks && proc.numDoubleBlocks == 0);
+        result.outputMatches = true;
+
+        // halving's exact in either precision, so the round trip shouldn't change a thing
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                result.outputMatches = result.outputMatches && output.getSample (ch, i) == input.getSample (ch, i) * gain;
+
+        std::sort (times.begin(), times.end());
+        result.meanMicroseconds = std::accumulate (times.begin(), times.end(), 0.0) / (double) times.size() * 1.0e6;
+        result.p99Microseconds  = Benchmark::percentile (times, 0.99) * 1.0e6;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 10.0);
+
+    const int blockSizes[] { 32, 64, 128, 256, 512, 1024, 2048 };
+
+    juce::Array<juce::var> results;
+    bool allChecksPassed = true;
+
+    for (auto blockSize : blockSizes)
+    {
+        const auto single = runBenchmark (blockSize, false, seconds);
+        const auto bridge = runBenchmark (blockSize, true,  seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("blockSize",              blockSize);
+        obj->setProperty ("singleMeanMicroseconds", single.meanMicroseconds);
+        obj->setProperty ("singleP99Microseconds",  single.p99Microseconds);
+        obj->setProperty ("doubleMeanMicroseconds", bridge.meanMicroseconds);
+        obj->setProperty ("doubleP99Microseconds",  bridge.p99Microseconds);
+        obj->setProperty ("bridgeOverheadMicroseconds", bridge.meanMicroseconds - single.meanMicroseconds);
+        obj->setProperty ("outputMatches",          single.outputMatches && bridge.outputMatches);
+
+        allChecksPassed = allChecksPassed && single.ranInRightPrecision && single.outputMatches
+                                          && bridge.ranInRightPrecision && bridge.outputMatches;
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("numChannels",       numChannels);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("allChecksPassed",   allChecksPassed);
+    report.set ("results",           results);
+
+    return report.write (args, allChecksPassed);
+}
@@ -0,0 +1,167 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "BenchmarkCommon.h"
+#include <numeric>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Runs PluginProcessor::processBlock on a simulated audio thread while another
+// thread hammers it with setStateInformation and setCurrentProgram calls, and
+// prints the worst-case block times (against the same run with no switching)
+// as JSON. The main thread runs the message loop, so the parameter objects are
+// kept in sync the way they would be in a host.
+//
+//  usage: preset_benchmark [--seconds=5] [--interval-ms=1] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int    blockSize  = 128;
+
+    struct BenchResult
+    {
+        int     numBlocks = 0, numSwitches = 0;
+        double  meanSeconds = 0, p99Seconds = 0, p999Seconds = 0, maxSeconds = 0;
+    };
+
+    struct AudioThread  : public juce::Thread
+    {
+        AudioThread (juce::AudioProcessor& p, int numBlocksIn)
+            : Thread ("Benchmark Audio"), proc (p), numBlocks (numBlocksIn) {}
+
+        void run() override
+        {
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            times.reserve ((size_t) numBlocks);
+
+            // paced like a real device, so the presets land between blocks as they would
+            const auto blockMs = 1000.0 * blockSize / sampleRate;
+            const auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+            for (int i = 0; i < numBlocks && ! threadShouldExit(); ++i)
+            {
+                buffer.clear();
+
+                const auto start = juce::Time::getHighResolutionTicks();
+                proc.processBlock (buffer, midi);
+                times.push_back (juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+
+                const auto nextBlockMs = startMs + (i + 1) * blockMs;
+
+                while (juce::Time::getMillisecondCounterHiRes() < nextBlockMs)
+                    std::this_thread::yield();
+            }
+        }
+
+        juce::AudioProcessor&   proc;
+        const int               numBlocks;
+        std::vector<double>     times;
+    };
+
+    struct SwitchingThread  : public juce::Thread
+    {
+        SwitchingThread (juce::AudioProcessor& p, int intervalMsIn)
+            : Thread ("Benchmark Presets"), proc (p), intervalMs (intervalMsIn) {}
+
+        void run() override
+        {
+            // a couple of saved states to flip between, alongside the programs
+            juce::MemoryBlock states[2];
+
+            for (int i = 0; i < 2; ++i)
+            {
+                proc.getParameters()[0]->setValueNotifyingHost ((float) i * 0.75f);
+                proc.getStateInformation (states[i]);
+            }
+
+            while (! threadShouldExit())
+            {
+                if (numSwitches % 3 == 0)
+                    proc.setCurrentProgram (numSwitches % proc.getNumPrograms());
+                else
+                    proc.setStateInformation (states[numSwitches % 2].getData(), (int) states[numSwitches % 2].getSize());
+
+                ++numSwitches;
+                wait (intervalMs);
+            }
+        }
+
+        juce::AudioProcessor&   proc;
+        const int               intervalMs;
+        int                     numSwitches = 0;
+    };
+
+    BenchResult runBenchmark (bool switchPresets, double seconds, int intervalMs)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        proc->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        proc->prepareToPlay (sampleRate, blockSize);
+
+        AudioThread audio (*proc, juce::roundToInt (seconds * sampleRate / blockSize));
+        SwitchingThread switcher (*proc, intervalMs);
+
+        audio.startThread (juce::Thread::Priority::high);
+
+        if (switchPresets)
+            switcher.startThread();
+
+        while (audio.isThreadRunning())
+            juce::MessageManager::getInstance()->runDispatchLoopUntil (10);
+
+        switcher.stopThread (1000);
+        proc->releaseResources();
+
+        auto& times = audio.times;
+        std::sort (times.begin(), times.end());
+
+        BenchResult result;
+        result.numBlocks    = (int) times.size();
+        result.numSwitches  = switcher.numSwitches;
+        result.meanSeconds  = std::accumulate (times.begin(), times.end(), 0.0) / (double) times.size();
+        result.p99Seconds   = Benchmark::percentile (times, 0.99);
+        result.p999Seconds  = Benchmark::percentile (times, 0.999);
+        result.maxSeconds   = times.back();
+        return result;
+    }
+
+    juce::var toVar (bool switchPresets, const BenchResult& result)
+    {
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("switchingPresets",   switchPresets);
+        obj->setProperty ("numBlocks",          result.numBlocks);
+        obj->setProperty ("numSwitches",        result.numSwitches);
+        obj->setProperty ("meanMicroseconds",   result.meanSeconds * 1.0e6);
+        obj->setProperty ("p99Microseconds",    result.p99Seconds  * 1.0e6);
+        obj->setProperty ("p999Microseconds",   result.p999Seconds * 1.0e6);
+        obj->setProperty ("maxMicroseconds",    result.maxSeconds  * 1.0e6);
+
+        return juce::var (obj);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds    = Benchmark::getOption (args, "--seconds", 5.0);
+    const auto intervalMs = juce::jmax (0, Benchmark::getOption (args, "--interval-ms", 1));
+
+    juce::Array<juce::var> results;
+
+    for (auto switchPresets : { false, true })
+        results.add (toVar (switchPresets, runBenchmark (switchPresets, seconds, intervalMs)));
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("switchIntervalMs",  intervalMs);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
@@ -0,0 +1,161 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "BenchmarkCommon.h"
+#include <numeric>
+#include <optional>
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Drives PluginProcessor::processBlock across a matrix of block sizes, sample
+// rates, channel layouts and precisions, and prints per-block timings as JSON.
+//
+//  usage: process_block_benchmark [--seconds=10] [--output=results.json]
+//
+// Build it in Release, otherwise you're mostly measuring DBG()...
+//==============================================================================
+namespace
+{
+    struct BenchConfig
+    {
+        int     blockSize = 0;
+        double  sampleRate = 0;
+        int     numChannels = 0;
+        bool    doublePrecision = false;
+    };
+
+    struct BenchResult
+    {
+        int     numBlocks = 0;
+        double  meanSeconds = 0, p99Seconds = 0, p999Seconds = 0, maxSeconds = 0;
+        double  realTimeFactor = 0; // seconds of audio processed per second of cpu
+    };
+
+    template <typename FloatType>
+    std::vector<double> timeBlocks (juce::AudioProcessor& proc, int numChannels, int blockSize, int numBlocks)
+    {
+        juce::AudioBuffer<FloatType> source (numChannels, blockSize), buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                source.setSample (ch, i, (FloatType) (random.nextFloat() - 0.5f));
+
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        // a few blocks to warm up caches and let the processor settle
+        const auto numWarmUpBlocks = juce::jmin (numBlocks, 64);
+
+        for (int i = -numWarmUpBlocks; i < numBlocks; ++i)
+        {
+            buffer.makeCopyOf (source, true);
+            midi.clear();
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            proc.processBlock (buffer, midi);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            if (i >= 0)
+                times.push_back (juce::Time::highResolutionTicksToSeconds (end - start));
+        }
+
+        return times;
+    }
+
+    std::optional<BenchResult> runBenchmark (const BenchConfig& config, double secondsOfAudio)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+
+        if (config.doublePrecision && ! proc->supportsDoublePrecisionProcessing())
+            return std::nullopt;
+
+        auto layout = proc->getBusesLayout();
+        const auto set = juce::AudioChannelSet::canonicalChannelSet (config.numChannels);
+
+        for (auto& bus : layout.inputBuses)     bus = set;
+        for (auto& bus : layout.outputBuses)    bus = set;
+
+        if (! proc->setBusesLayout (layout))
+            return std::nullopt;
+
+        proc->setRateAndBufferSizeDetails (config.sampleRate, config.blockSize);
+        proc->setProcessingPrecision (config.doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                             : juce::AudioProcessor::singlePrecision);
+        proc->prepareToPlay (config.sampleRate, config.blockSize);
+
+        const auto numChannels = juce::jmax (proc->getTotalNumInputChannels(), proc->getTotalNumOutputChannels());
+        const auto numBlocks   = juce::jmax (1, juce::roundToInt (secondsOfAudio * config.sampleRate / config.blockSize));
+
+        auto times = config.doublePrecision ? timeBlocks<double> (*proc, numChannels, config.blockSize, numBlocks)
+                                            : timeBlocks<float>  (*proc, numChannels, config.blockSize, numBlocks);
+        proc->releaseResources();
+
+        std::sort (times.begin(), times.end());
+        const auto total = std::accumulate (times.begin(), times.end(), 0.0);
+
+        BenchResult result;
+        result.numBlocks      = (int) times.size();
+        result.meanSeconds    = total / (double) times.size();
+        result.p99Seconds     = Benchmark::percentile (times, 0.99);
+        result.p999Seconds    = Benchmark::percentile (times, 0.999);
+        result.maxSeconds     = times.back();
+        result.realTimeFactor = total > 0 ? ((double) numBlocks * config.blockSize / config.sampleRate) / total
+                                          : 0.0;
+        return result;
+    }
+
+    juce::var toVar (const BenchConfig& config, const BenchResult& result)
+    {
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("blockSize",          config.blockSize);
+        obj->setProperty ("sampleRate",         config.sampleRate);
+        obj->setProperty ("numChannels",        config.numChannels);
+        obj->setProperty ("precision",          config.doublePrecision ? "double" : "single");
+        obj->setProperty ("numBlocks",          result.numBlocks);
+        obj->setProperty ("meanMicroseconds",   result.meanSeconds * 1.0e6);
+        obj->setProperty ("p99Microseconds",    result.p99Seconds  * 1.0e6);
+        obj->setProperty ("p999Microseconds",   result.p999Seconds * 1.0e6);
+        obj->setProperty ("maxMicroseconds",    result.maxSeconds  * 1.0e6);
+        obj->setProperty ("realTimeFactor",     result.realTimeFactor);
+
+        return juce::var (obj);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+
+    const auto secondsOfAudio = Benchmark::getOption (args, "--seconds", 10.0);
+
+    const int    blockSizes[]   { 32, 64, 128, 256, 512, 1024, 2048 };
+    const double sampleRates[]  { 44100.0, 48000.0, 96000.0 };
+    const int    channelCounts[]{ 1, 2 };
+    const bool   precisions[]   { false, true };
+
+    juce::Array<juce::var> results;
+
+    for (auto doublePrecision : precisions)
+        for (auto numChannels : channelCounts)
+            for (auto sampleRate : sampleRates)
+                for (auto blockSize : blockSizes)
+                {
+                    const BenchConfig config { blockSize, sampleRate, numChannels, doublePrecision };
+
+                    if (auto result = runBenchmark (config, secondsOfAudio))
+                        results.add (toVar (config, *result));
+                }
+
+    Benchmark::Report report;
+    std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+
+    report.set ("plugin",            proc->getName());
+    report.set ("secondsPerConfig",  secondsOfAudio);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
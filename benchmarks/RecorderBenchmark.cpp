@@ -0,0 +1,205 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Records the plugin's output through AudioTransportPlayer's record mode while the
+// file it's writing to stalls now and then, and prints the dropped samples,
+// callback overruns and longest write as JSON. The render is paced to real time a
+// block at a time, like a device would drive it, and the file's read back
+// afterwards to check every sample made it there.
+//
+// None of the stalls are longer than the recorder's ring, so anything dropped (or
+// any overrun) is a failure.
+//
+//  usage: recorder_benchmark [--seconds=60] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate  = 48000.0;
+    constexpr int    blockSize   = 256;
+    constexpr int    numChannels = 2;
+
+    //==============================================================================
+    /** Passes everything on to a file, but goes to sleep for stallMs every stallEveryMs. */
+    struct StallingOutputStream  : public juce::OutputStream
+    {
+        StallingOutputStream (const juce::File& file, int stallMsIn, int stallEveryMsIn)
+            : out (file), stallMs (stallMsIn), stallEveryMs (stallEveryMsIn)
+        {
+        }
+
+        bool write (const void* data, size_t numBytes) override
+        {
+            const auto now = juce::Time::getMillisecondCounter();
+
+            if (stallMs > 0 && now - lastStall >= (juce::uint32) stallEveryMs)
+            {
+                juce::Thread::sleep (stallMs);
+                lastStall = juce::Time::getMillisecondCounter();
+                ++numStalls;
+            }
+
+            return out.write (data, numBytes);
+        }
+
+        void flush() override                           { out.flush(); }
+        bool setPosition (juce::int64 pos) override     { return out.setPosition (pos); }
+        juce::int64 getPosition() override              { return out.getPosition(); }
+
+        juce::FileOutputStream  out;
+        int                     stallMs, stallEveryMs;
+        juce::uint32            lastStall = juce::Time::getMillisecondCounter();
+        std::atomic<int>        numStalls { 0 };
+    };
+
+    //==============================================================================
+    struct BenchResult
+    {
+        juce::int64     samplesRecorded = 0, samplesDropped = 0, samplesInFile = 0, wrongSamples = 0;
+        juce::uint64    callbackOverruns = 0;
+        double          maxCallbackLoad = 0, maxRingUsage = 0, longestWriteMs = 0;
+        int             numStalls = 0;
+    };
+
+    BenchResult runBenchmark (const juce::File& file, int stallMs, int stallEveryMs, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        const auto numBlocks = juce::roundToInt (seconds * sampleRate / blockSize);
+        juce::AudioBuffer<float> input (numChannels, numBlocks * blockSize), output (numChannels, blockSize);
+        juce::Random random (0x5eed);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < input.getNumSamples(); ++i)
+                input.setSample (ch, i, random.nextFloat() - 0.5f);
+
+        file.deleteFile();
+
+        // 32 bit float, so what's read back is bit-exact
+        auto stream  = std::make_unique<StallingOutputStream> (file, stallMs, stallEveryMs);
+        auto* stalls = stream.get();
+        auto recorder = std::make_unique<OutputRecorder>();
+        juce::WavAudioFormat wav;
+
+        if (recorder->start (std::move (stream), wav, sampleRate, numChannels, 32, 10.0).failed())
+            return {};
+
+        auto* recording = recorder.get();
+        player.startRecording (std::move (recorder));
+
+        // paced like a device, so its blocks belong in the stats
+        player.setOfflineRendersCounted (true);
+        player.getCallbackStats().reset();
+
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            // wait until the block would be due, as if a device were asking for it
+            const auto due = start + (i * blockSize) * 1000.0 / sampleRate;
+            const auto now = juce::Time::getMillisecondCounterHiRes();
+
+            if (due > now)
+                juce::Time::waitForMillisecondCounter ((juce::uint32) due);
+
+            juce::AudioBuffer<float> block (input.getArrayOfWritePointers(), numChannels, i * blockSize, blockSize);
+            player.renderOffline (&block, output, 0, blockSize);
+        }
+
+        const auto stats = player.getCallbackStats().getSnapshot();
+
+        BenchResult result;
+        result.callbackOverruns = stats.numOverruns;
+        result.maxCallbackLoad  = stats.maxLoad;
+        result.samplesRecorded  = recording->getNumSamplesRecorded();
+        result.samplesDropped   = recording->getNumSamplesDropped();
+        result.maxRingUsage     = recording->getMaxRingUsage();
+        result.longestWriteMs   = recording->getLongestWriteMs();
+        result.numStalls        = stalls->numStalls.load();
+
+        // waits for the rest to be written
+        player.stopRecording();
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+
+        std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (new juce::FileInputStream (file), true));
+
+        if (reader != nullptr)
+        {
+            result.samplesInFile = reader->lengthInSamples;
+
+            juce::AudioBuffer<float> readBack (numChannels, (int) reader->lengthInSamples);
+            reader->read (&readBack, 0, readBack.getNumSamples(), 0, true, true);
+
+            // it's a unity gain plugin, so the file should be the input
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < juce::jmin (readBack.getNumSamples(), input.getNumSamples()); ++i)
+                    if (readBack.getSample (ch, i) != input.getSample (ch, i))
+                        ++result.wrongSamples;
+        }
+
+        file.deleteFile();
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 60.0);
+
+    const auto file = juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile ("recorder_benchmark.wav");
+
+    // stall length, how often
+    const std::pair<int, int> stalls[] { { 0, 0 }, { 250, 1000 }, { 2000, 5000 }, { 8000, 20000 } };
+
+    juce::Array<juce::var> results;
+    bool allPassed = true;
+
+    for (const auto& [stallMs, stallEveryMs] : stalls)
+    {
+        const auto result = runBenchmark (file, stallMs, stallEveryMs, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("stallMs",            stallMs);
+        obj->setProperty ("stallEveryMs",       stallEveryMs);
+        obj->setProperty ("numStalls",          result.numStalls);
+        obj->setProperty ("samplesRecorded",    result.samplesRecorded);
+        obj->setProperty ("samplesDropped",     result.samplesDropped);
+        obj->setProperty ("samplesInFile",      result.samplesInFile);
+        obj->setProperty ("wrongSamples",       result.wrongSamples);
+        obj->setProperty ("callbackOverruns",   (juce::int64) result.callbackOverruns);
+        obj->setProperty ("maxCallbackLoad",    result.maxCallbackLoad);
+        obj->setProperty ("maxRingUsage",       result.maxRingUsage);
+        obj->setProperty ("longestWriteMs",     result.longestWriteMs);
+
+        allPassed = allPassed && result.samplesDropped == 0 && result.callbackOverruns == 0
+                     && result.wrongSamples == 0 && result.samplesInFile == result.samplesRecorded
+                     && result.samplesRecorded == juce::roundToInt (seconds * sampleRate / blockSize) * blockSize;
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("numChannels",       numChannels);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("allPassed",         allPassed);
+    report.set ("results",           results);
+
+    return report.write (args, allPassed);
+}
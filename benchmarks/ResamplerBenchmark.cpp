@@ -0,0 +1,116 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin offline through AudioTransportPlayer at one device rate with
+// the processor running at another, for the 44.1k <-> 48k and 96k <-> 48k pairs,
+// and prints the throughput (and overhead against running at the device's rate)
+// as JSON. Each run also pushes an impulse through and finds where the peak comes
+// out, to check against the latency the player reports.
+//
+//  usage: resampler_benchmark [--seconds=30] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr int blockSize   = 512;
+    constexpr int numChannels = 2;
+
+    struct BenchResult
+    {
+        double  realTimeFactor = 0;
+        int     reportedLatency = 0, measuredLatency = -1;
+    };
+
+    BenchResult runBenchmark (double deviceRate, double internalRate, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        const auto numSamples = juce::roundToInt (seconds * deviceRate);
+
+        player.setProcessor (proc.get());
+        player.setInternalSampleRate (internalRate);
+        player.prepareOfflineRender (deviceRate, blockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> input (numChannels, numSamples), output (numChannels, numSamples);
+        input.clear();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            input.setSample (ch, 0, 1.0f);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        player.renderOffline (&input, output, 0, numSamples);
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        BenchResult result;
+        result.realTimeFactor  = elapsed > 0 ? seconds / elapsed : 0.0;
+        result.reportedLatency = player.getTotalLatencySamples();
+
+        // the resamplers smear the impulse out, so it's the peak that counts
+        const auto searchLength = juce::jmin (numSamples, juce::roundToInt (deviceRate * 0.1));
+        auto peak = 0.0f;
+
+        for (int i = 0; i < searchLength; ++i)
+        {
+            if (std::abs (output.getSample (0, i)) > peak)
+            {
+                peak = std::abs (output.getSample (0, i));
+                result.measuredLatency = i;
+            }
+        }
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 30.0);
+
+    // device rate, internal rate
+    const std::pair<double, double> ratePairs[] { { 44100.0, 48000.0 }, { 48000.0, 44100.0 },
+                                                  { 96000.0, 48000.0 }, { 48000.0, 96000.0 } };
+
+    juce::Array<juce::var> results;
+    bool allLatenciesMatch = true;
+
+    for (const auto& [deviceRate, internalRate] : ratePairs)
+    {
+        const auto baseline = runBenchmark (deviceRate, 0.0, seconds);
+        const auto result   = runBenchmark (deviceRate, internalRate, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("deviceSampleRate",           deviceRate);
+        obj->setProperty ("internalSampleRate",         internalRate);
+        obj->setProperty ("realTimeFactor",             result.realTimeFactor);
+        obj->setProperty ("deviceRateRealTimeFactor",   baseline.realTimeFactor);
+        obj->setProperty ("overheadPercent",            result.realTimeFactor > 0 ? (baseline.realTimeFactor / result.realTimeFactor - 1.0) * 100.0 : 0.0);
+        obj->setProperty ("reportedLatency",            result.reportedLatency);
+        obj->setProperty ("measuredLatency",            result.measuredLatency);
+        obj->setProperty ("latencyMilliseconds",        result.reportedLatency * 1000.0 / deviceRate);
+
+        // the peak of a band-limited impulse can land a sample either side
+        allLatenciesMatch = allLatenciesMatch && std::abs (result.reportedLatency - result.measuredLatency) <= 1;
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("blockSize",          blockSize);
+    report.set ("tapsPerPhase",       PolyphaseResampler::tapsPerPhase);
+    report.set ("secondsPerConfig",   seconds);
+    report.set ("allLatenciesMatch",  allLatenciesMatch);
+    report.set ("results",            results);
+
+    return report.write (args, allLatenciesMatch);
+}
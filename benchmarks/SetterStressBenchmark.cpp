@@ -0,0 +1,155 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "../shared/standalone/VirtualAudioDevice.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Runs the plugin through AudioTransportPlayer on a VirtualAudioIODevice, first on
+// its own and then while another thread calls the player's setters (tempo, MIDI
+// output, precision, sub-block splitting and the transport) as fast as it can, and
+// prints the worst callback time of each half as JSON.
+//
+// The callback only ever picks up whatever state was last handed to it, so the
+// setters shouldn't make the worst case any worse than it is without them.
+//
+//  usage: setter_stress_benchmark [--seconds=20] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+
+    /** Calls every setter in turn until it's stopped. */
+    struct HammerThread  : public juce::Thread
+    {
+        explicit HammerThread (AudioTransportPlayer& playerIn)
+            : juce::Thread ("Setter Stress"), player (playerIn)
+        {
+        }
+
+        void run() override
+        {
+            juce::Random random (0x5eed);
+
+            while (! threadShouldExit())
+            {
+                player.setBPM (60.0 + random.nextDouble() * 120.0);
+                player.setMidiOutput (nullptr);
+                player.setDoublePrecisionProcessing (! player.getDoublePrecisionProcessing());
+                player.setSubBlockSplitting (random.nextBool() ? 0 : 32);
+
+                if (random.nextBool())
+                    player.getPlayHead().play();
+                else
+                    player.getPlayHead().stop();
+
+                ++numRounds;
+            }
+        }
+
+        AudioTransportPlayer&   player;
+        int                     numRounds = 0;
+    };
+
+    struct BenchResult
+    {
+        int             numRounds = 0;
+        double          quietMaxCallbackMs = 0, stressedMaxCallbackMs = 0;
+        juce::uint64    quietOverruns = 0, stressedOverruns = 0;
+    };
+
+    BenchResult runBenchmark (int bufferSize, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+        juce::AudioDeviceManager manager;
+
+        VirtualAudioIODevice::Settings settings;
+        settings.sampleRate        = sampleRate;
+        settings.bufferSize        = bufferSize;
+        settings.numInputChannels  = proc->getTotalNumInputChannels();
+        settings.numOutputChannels = proc->getTotalNumOutputChannels();
+
+        manager.addAudioDeviceType (std::make_unique<VirtualAudioIODeviceType> (settings));
+
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        setup.outputDeviceName = VirtualAudioIODeviceType::deviceName;
+        setup.inputDeviceName  = VirtualAudioIODeviceType::deviceName;
+        setup.sampleRate       = sampleRate;
+        setup.bufferSize       = bufferSize;
+
+        BenchResult result;
+
+        if (manager.initialise (settings.numInputChannels, settings.numOutputChannels, nullptr, false, {}, &setup).isNotEmpty())
+            return result;
+
+        player.setProcessor (proc.get());
+        player.getPlayHead().play();
+        manager.addAudioCallback (&player);
+
+        const auto periodMs = bufferSize * 1000.0 / sampleRate;
+        const auto halfMs   = juce::roundToInt (seconds * 500.0);
+
+        juce::Thread::sleep (halfMs);
+
+        const auto quiet = player.getCallbackStats().getSnapshot();
+        result.quietMaxCallbackMs = quiet.maxLoad * periodMs;
+        result.quietOverruns      = quiet.numOverruns;
+
+        player.getCallbackStats().reset();
+
+        HammerThread hammer (player);
+        hammer.startThread();
+        juce::Thread::sleep (halfMs);
+        hammer.stopThread (-1);
+
+        const auto stressed = player.getCallbackStats().getSnapshot();
+        result.stressedMaxCallbackMs = stressed.maxLoad * periodMs;
+        result.stressedOverruns      = stressed.numOverruns;
+        result.numRounds             = hammer.numRounds;
+
+        manager.removeAudioCallback (&player);
+        manager.closeAudioDevice();
+        player.setProcessor (nullptr);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds = Benchmark::getOption (args, "--seconds", 20.0);
+
+    const int bufferSizes[] { 64, 256, 1024 };
+
+    juce::Array<juce::var> results;
+
+    for (auto bufferSize : bufferSizes)
+    {
+        const auto result = runBenchmark (bufferSize, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("bufferSize",             bufferSize);
+        obj->setProperty ("periodMs",               bufferSize * 1000.0 / sampleRate);
+        obj->setProperty ("numSetterRounds",        result.numRounds);
+        obj->setProperty ("quietMaxCallbackMs",     result.quietMaxCallbackMs);
+        obj->setProperty ("stressedMaxCallbackMs",  result.stressedMaxCallbackMs);
+        obj->setProperty ("quietOverruns",          (juce::int64) result.quietOverruns);
+        obj->setProperty ("stressedOverruns",       (juce::int64) result.stressedOverruns);
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
@@ -0,0 +1,150 @@
+#include "../ProcessorState.h"
+#include "BenchmarkCommon.h"
+
+//==============================================================================
+// Compares the binary format in ProcessorState.h against the usual ValueTree ->
+// XML -> copyXmlToBinary route, for saving and loading states with thousands of
+// parameters, and prints timings and sizes as JSON.
+//
+//  usage: state_benchmark [--iterations=200] [--output=results.json]
+//==============================================================================
+namespace
+{
+    struct BenchResult
+    {
+        size_t  numBytes = 0;
+        double  meanSaveSeconds = 0, meanLoadSeconds = 0;
+    };
+
+    struct ParameterSet
+    {
+        explicit ParameterSet (int numParams)
+        {
+            juce::Random random (0x5eed);
+
+            for (int i = 0; i < numParams; ++i)
+            {
+                auto* p = owned.add (new juce::AudioParameterFloat ({ "param" + juce::String (i), 1 },
+                                                                    "Param " + juce::String (i),
+                                                                    0.0f, 1.0f, 0.5f));
+                p->setValueNotifyingHost (random.nextFloat());
+                params.add (p);
+            }
+        }
+
+        juce::OwnedArray<juce::AudioParameterFloat>     owned;
+        juce::Array<juce::AudioProcessorParameter*>     params;
+    };
+
+    template <typename Fn>
+    double timeIt (int iterations, Fn&& fn)
+    {
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < iterations; ++i)
+            fn();
+
+        return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start) / iterations;
+    }
+
+    BenchResult benchmarkBinary (ParameterSet& set, int iterations)
+    {
+        juce::MemoryBlock block;
+        BenchResult result;
+
+        result.meanSaveSeconds = timeIt (iterations, [&]
+        {
+            ProcessorState::Writer writer (block);
+            writer.writeHeader();
+            writer.writeParameters (set.params);
+        });
+
+        result.meanLoadSeconds = timeIt (iterations, [&]
+        {
+            if (const auto reader = ProcessorState::Reader::open (block.getData(), (int) block.getSize()))
+                reader->applyParameters (set.params);
+        });
+
+        result.numBytes = block.getSize();
+        return result;
+    }
+
+    BenchResult benchmarkValueTreeXml (ParameterSet& set, int iterations)
+    {
+        juce::MemoryBlock block;
+        BenchResult result;
+
+        result.meanSaveSeconds = timeIt (iterations, [&]
+        {
+            juce::ValueTree state ("STATE");
+
+            for (auto* p : set.owned)
+                state.appendChild (juce::ValueTree ("PARAM", { { "id", p->getParameterID() }, { "value", p->getValue() } }), nullptr);
+
+            block.reset();
+            juce::AudioProcessor::copyXmlToBinary (*state.createXml(), block);
+        });
+
+        result.meanLoadSeconds = timeIt (iterations, [&]
+        {
+            if (const auto xml = juce::AudioProcessor::getXmlFromBinary (block.getData(), (int) block.getSize()))
+            {
+                const auto state = juce::ValueTree::fromXml (*xml);
+
+                // same in-order fast path as the binary reader gets
+                for (int i = 0; i < juce::jmin (state.getNumChildren(), set.owned.size()); ++i)
+                {
+                    const auto child = state.getChild (i);
+                    auto* p = set.owned.getUnchecked (i);
+
+                    if (child["id"].toString() == p->getParameterID())
+                        p->setValueNotifyingHost ((float) child["value"]);
+                }
+            }
+        });
+
+        result.numBytes = block.getSize();
+        return result;
+    }
+
+    juce::var toVar (int numParams, const char* format, const BenchResult& result)
+    {
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("numParameters",          numParams);
+        obj->setProperty ("format",                 format);
+        obj->setProperty ("numBytes",               (juce::int64) result.numBytes);
+        obj->setProperty ("meanSaveMicroseconds",   result.meanSaveSeconds * 1.0e6);
+        obj->setProperty ("meanLoadMicroseconds",   result.meanLoadSeconds * 1.0e6);
+
+        return juce::var (obj);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+
+    const auto iterations = juce::jmax (1, Benchmark::getOption (args, "--iterations", 200));
+
+    const int parameterCounts[] { 100, 1000, 5000, 10000 };
+
+    juce::Array<juce::var> results;
+
+    for (auto numParams : parameterCounts)
+    {
+        ParameterSet set (numParams);
+
+        results.add (toVar (numParams, "binary",       benchmarkBinary       (set, iterations)));
+        results.add (toVar (numParams, "valueTreeXml", benchmarkValueTreeXml (set, iterations)));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("formatVersion",        juce::String (ProcessorState::majorVersion) + "." + juce::String (ProcessorState::minorVersion));
+    report.set ("iterationsPerConfig",  iterations);
+    report.set ("results",              results);
+
+    return report.write (args);
+}
@@ -0,0 +1,106 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Renders the plugin offline through AudioTransportPlayer with MIDI at various
+// densities, with sub-block splitting off and at a few minimum sizes, and prints
+// the throughput (and overhead against splitting being off) as JSON.
+//
+//  usage: sub_block_benchmark [--seconds=30] [--output=results.json]
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int    blockSize  = 512;
+    constexpr int    numChannels = 2;
+
+    /** Evenly spaced note ons/offs, at the given number of events per second. */
+    juce::MidiBuffer makeEvents (int eventsPerSecond, int numSamples)
+    {
+        juce::MidiBuffer midi;
+
+        if (eventsPerSecond <= 0)
+            return midi;
+
+        const auto spacing = sampleRate / eventsPerSecond;
+
+        for (int i = 0; i * spacing < numSamples; ++i)
+        {
+            const auto message = (i & 1) == 0 ? juce::MidiMessage::noteOn  (1, 60, 0.8f)
+                                              : juce::MidiMessage::noteOff (1, 60);
+            midi.addEvent (message, juce::roundToInt (i * spacing));
+        }
+
+        return midi;
+    }
+
+    /** Seconds of audio rendered per second of CPU. */
+    double measureRealTimeFactor (int minSubBlockSize, const juce::MidiBuffer& midi, int numSamples)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+
+        player.setProcessor (proc.get());
+        player.setSubBlockSplitting (minSubBlockSize);
+        player.prepareOfflineRender (sampleRate, blockSize, { numChannels, numChannels });
+
+        juce::AudioBuffer<float> input (numChannels, numSamples), output (numChannels, numSamples);
+        input.clear();
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        player.renderOffline (&input, output, 0, numSamples, &midi);
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        player.releaseOfflineRender();
+        player.setProcessor (nullptr);
+
+        return elapsed > 0 ? (numSamples / sampleRate) / elapsed : 0.0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds    = Benchmark::getOption (args, "--seconds", 30.0);
+    const auto numSamples = juce::roundToInt (seconds * sampleRate);
+
+    const int eventDensities[]   { 0, 10, 100, 1000, 10000 };
+    const int minSubBlockSizes[] { 0, 1, 16, 64, 256 };
+
+    juce::Array<juce::var> results;
+
+    for (auto eventsPerSecond : eventDensities)
+    {
+        const auto midi     = makeEvents (eventsPerSecond, numSamples);
+        const auto baseline = measureRealTimeFactor (0, midi, numSamples);
+
+        for (auto minSize : minSubBlockSizes)
+        {
+            const auto factor = minSize == 0 ? baseline : measureRealTimeFactor (minSize, midi, numSamples);
+            auto* obj = new juce::DynamicObject();
+
+            obj->setProperty ("eventsPerSecond",    eventsPerSecond);
+            obj->setProperty ("minSubBlockSize",    minSize);
+            obj->setProperty ("realTimeFactor",     factor);
+            obj->setProperty ("overheadPercent",    factor > 0 ? (baseline / factor - 1.0) * 100.0 : 0.0);
+
+            results.add (juce::var (obj));
+        }
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("blockSize",         blockSize);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
@@ -0,0 +1,109 @@
+#include <JuceHeader.h>
+#include "../shared/standalone/TransportPlayer.h"
+#include "../shared/standalone/VirtualAudioDevice.h"
+#include "BenchmarkCommon.h"
+
+// defined in PluginProcessor.cpp
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter();
+
+//==============================================================================
+// Runs the plugin through AudioTransportPlayer on a VirtualAudioIODevice, opened
+// through an AudioDeviceManager just like the standalone app's, at a few buffer
+// sizes, and prints the device's deadline misses and wake-up lateness alongside
+// the player's callback stats as JSON. No sound hardware needed, so it'll soak
+// test the audio side of the standalone stack on a CPU-only machine.
+//
+//  usage: virtual_device_benchmark [--seconds=30] [--sample-rate=48000] [--output=results.json]
+//==============================================================================
+namespace
+{
+    struct BenchResult
+    {
+        VirtualAudioIODevice::Snapshot  device;
+        CallbackStats::Snapshot         callbacks;
+    };
+
+    BenchResult runBenchmark (double sampleRate, int bufferSize, double seconds)
+    {
+        std::unique_ptr<juce::AudioProcessor> proc (createPluginFilter());
+        AudioTransportPlayer player;
+        juce::AudioDeviceManager manager;
+
+        VirtualAudioIODevice::Settings settings;
+        settings.sampleRate        = sampleRate;
+        settings.bufferSize        = bufferSize;
+        settings.numInputChannels  = proc->getTotalNumInputChannels();
+        settings.numOutputChannels = proc->getTotalNumOutputChannels();
+
+        manager.addAudioDeviceType (std::make_unique<VirtualAudioIODeviceType> (settings));
+
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        setup.outputDeviceName = VirtualAudioIODeviceType::deviceName;
+        setup.inputDeviceName  = VirtualAudioIODeviceType::deviceName;
+        setup.sampleRate       = sampleRate;
+        setup.bufferSize       = bufferSize;
+
+        BenchResult result;
+
+        if (manager.initialise (settings.numInputChannels, settings.numOutputChannels, nullptr, false, {}, &setup).isNotEmpty())
+            return result;
+
+        player.setProcessor (proc.get());
+        player.getPlayHead().play();
+        manager.addAudioCallback (&player);
+
+        juce::Thread::sleep (juce::roundToInt (seconds * 1000.0));
+
+        if (auto* device = dynamic_cast<VirtualAudioIODevice*> (manager.getCurrentAudioDevice()))
+            result.device = device->getSnapshot();
+
+        result.callbacks = player.getCallbackStats().getSnapshot();
+
+        manager.removeAudioCallback (&player);
+        manager.closeAudioDevice();
+        player.setProcessor (nullptr);
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    const auto seconds    = Benchmark::getOption (args, "--seconds", 30.0);
+    const auto sampleRate = Benchmark::getOption (args, "--sample-rate", 48000.0);
+
+    const int bufferSizes[] { 64, 128, 256, 512 };
+
+    juce::Array<juce::var> results;
+
+    for (auto bufferSize : bufferSizes)
+    {
+        const auto result = runBenchmark (sampleRate, bufferSize, seconds);
+        auto* obj = new juce::DynamicObject();
+
+        obj->setProperty ("bufferSize",         bufferSize);
+        obj->setProperty ("periodMs",           bufferSize * 1000.0 / sampleRate);
+        obj->setProperty ("numCallbacks",       (juce::int64) result.device.numCallbacks);
+        obj->setProperty ("numDeadlineMisses",  (juce::int64) result.device.numDeadlineMisses);
+        obj->setProperty ("numPeriodsSkipped",  (juce::int64) result.device.numPeriodsSkipped);
+        obj->setProperty ("maxLatenessMs",      result.device.maxLatenessMs);
+        obj->setProperty ("meanLatenessMs",     result.device.meanLatenessMs);
+        obj->setProperty ("maxJitterMs",        result.callbacks.maxJitterMs);
+        obj->setProperty ("numOverruns",        (juce::int64) result.callbacks.numOverruns);
+        obj->setProperty ("numXruns",           (juce::int64) result.callbacks.numXruns);
+        obj->setProperty ("maxLoad",            result.callbacks.maxLoad);
+
+        results.add (juce::var (obj));
+    }
+
+    Benchmark::Report report;
+
+    report.set ("sampleRate",        sampleRate);
+    report.set ("secondsPerConfig",  seconds);
+    report.set ("results",           results);
+
+    return report.write (args);
+}
@@ -3,48 +3,351 @@
 
 
 //==============================================================================
-struct PluginEditorComponent     : public Component
-{  
-    using ProcEditor   = std::unique_ptr<AudioProcessorEditor>;
-    using GridLayouFn  = std::function<Grid(Component*)>;
+/** Collects repaint requests from any number of components and flushes them all
+    together, at most once per display frame, rather than each component repainting
+    whenever it likes. Meters and animations can call markDirty as often as they
+    want - repeated requests for the same component are merged into one.
 
-    PluginEditorComponent(ProcEditor editorIn, GridLayouFn layoutIn = nullptr)
-    : editor (std::move (editorIn)), layout (std::move (layoutIn))
+    Anything that has to check something to find out whether it needs repainting
+    (e.g. a meter showing values the audio thread writes) can add a poll, rather than
+    running a timer of its own. Polls are checked pollsPerSecond times a second and
+    should markDirty whatever they find has changed.
+
+    The timer runs at the frame rate while there's something to flush, at the poll
+    rate while there are polls but nothing to flush, and not at all otherwise - so
+    an idle window with nothing to check doesn't wake the message thread.
+
+    It also counts the frames it flushes, and times PluginEditorComponent's own paint
+    pass (from its paint() to its paintOverChildren()) if whoever owns it calls
+    beginPaint() and endPaint() around it. A pass where only opaque children were
+    repainted skips paint(), so isn't timed.
+
+    Message thread only.
+*/
+struct RepaintScheduler     : private Timer
+{
+    explicit RepaintScheduler (int framesPerSecondIn = 60, int pollsPerSecondIn = 15)
+        : framesPerSecond (framesPerSecondIn), pollsPerSecond (pollsPerSecondIn) {}
+
+    void markDirty (Component& comp)
     {
-        addAndMakeVisible (editor.get());
-        childBoundsChanged (editor.get());
+        markDirty (comp, comp.getLocalBounds());
     }
 
-    void childBoundsChanged (Component* child) override
+    void markDirty (Component& comp, Rectangle<int> area)
+    {
+        JUCE_ASSERT_MESSAGE_THREAD
+
+        for (auto& entry : dirty)
+        {
+            if (entry.component == &comp)
+            {
+                entry.area.add (area);
+                return;
+            }
+        }
+
+        dirty.push_back ({ &comp, RectangleList<int> (area) });
+        updateTimer();
+    }
+
+    /** True while the scheduler's calling repaint() on the components it's flushing. */
+    bool isFlushing() const noexcept                { return flushing; }
+
+    //==============================================================================
+    /** Calls `poll` pollsPerSecond times a second for as long as `owner` exists (or
+        until removePoll is called). Polls mustn't add or remove polls themselves.
+    */
+    void addPoll (Component& owner, std::function<void()> poll)
+    {
+        JUCE_ASSERT_MESSAGE_THREAD
+
+        polls.push_back ({ &owner, std::move (poll) });
+        updateTimer();
+    }
+
+    void removePoll (Component& owner)
+    {
+        JUCE_ASSERT_MESSAGE_THREAD
+
+        polls.erase (std::remove_if (polls.begin(), polls.end(),
+                                     [&owner] (const Poll& p) { return p.owner == &owner; }),
+                     polls.end());
+        updateTimer();
+    }
+
+    //==============================================================================
+    void beginPaint() noexcept      { paintStartTicks = Time::getHighResolutionTicks(); }
+
+    void endPaint() noexcept
     {
-        if (child != editor.get()) 
+        if (paintStartTicks == 0)
             return;
-        
-        else if (child == editor.get())
+
+        lastPaintMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - paintStartTicks) * 1000.0;
+        maxPaintMs  = jmax (maxPaintMs, lastPaintMs);
+        totalPaintMs += lastPaintMs;
+        ++numPaints;
+        paintStartTicks = 0;
+    }
+
+    /** How many times the scheduler's flushed its dirty components. */
+    int getNumFramesFlushed() const noexcept        { return numFramesFlushed; }
+
+    int getNumTimedPaints() const noexcept          { return numPaints; }
+    double getLastPaintMs() const noexcept          { return lastPaintMs; }
+    double getMaxPaintMs() const noexcept           { return maxPaintMs; }
+    double getAveragePaintMs() const noexcept       { return numPaints > 0 ? totalPaintMs / numPaints : 0.0; }
+
+private:
+    struct DirtyComponent
+    {
+        Component::SafePointer<Component>   component;
+        RectangleList<int>                  area;
+    };
+
+    struct Poll
+    {
+        Component::SafePointer<Component>   owner;
+        std::function<void()>               check;
+    };
+
+    void updateTimer()
+    {
+        const auto rate = ! dirty.empty() ? framesPerSecond
+                        : ! polls.empty() ? pollsPerSecond
+                                          : 0;
+        if (rate == 0)
+        {
+            stopTimer();
+        }
+        else if (rate != timerRate || ! isTimerRunning())
         {
-            auto size = editor.get()->getBounds();
+            // restarting resets the countdown, so only when the rate's changing
+            startTimerHz (rate);
+        }
+
+        timerRate = rate;
+    }
 
-            if (!layout) 
+    void runPolls()
+    {
+        const auto now = Time::getMillisecondCounter();
+
+        // ticking at the poll rate, every tick's a poll (however early the timer fires)
+        if (timerRate != pollsPerSecond && now - lastPollTime < (uint32) (1000 / pollsPerSecond))
+            return;
+
+        lastPollTime = now;
+
+        polls.erase (std::remove_if (polls.begin(), polls.end(), [] (const Poll& p) { return p.owner == nullptr; }),
+                     polls.end());
+
+        for (auto& p : polls)
+            p.check();
+    }
+
+    void timerCallback() override
+    {
+        runPolls();
+
+        if (! dirty.empty())
+        {
+            const ScopedValueSetter<bool> svs (flushing, true);
+
+            for (auto& entry : dirty)
             {
-                setSize(size.getWidth(), size.getHeight());
-                return;
+                if (entry.component == nullptr)
+                    continue;
+
+                entry.area.consolidate();
+
+                for (const auto& r : entry.area)
+                    entry.component->repaint (r);
             }
 
-            else if (layout)
+            dirty.clear();
+            ++numFramesFlushed;
+        }
+
+        updateTimer();
+    }
+
+    const int                       framesPerSecond, pollsPerSecond;
+    std::vector<DirtyComponent>     dirty;
+    std::vector<Poll>               polls;
+    int                             timerRate = 0;
+    uint32                          lastPollTime = 0;
+    bool                            flushing = false;
+
+    int64                           paintStartTicks = 0;
+    int                             numFramesFlushed = 0, numPaints = 0;
+    double                          lastPaintMs = 0, maxPaintMs = 0, totalPaintMs = 0;
+};
+
+
+
+//==============================================================================
+/** A CachedComponentImage that keeps one raster of its component per scale factor.
+
+    The component is only re-rendered where it (or one of its children) has called
+    repaint(), so repaints that just pass over it - a parent, a sibling, the window
+    being uncovered - blit the cached image instead of calling paint() again. When
+    the scale changes, e.g. the window moves to another display or setScaleFactor is
+    called, the raster for the new scale is kept alongside the old one, so flipping
+    back and forth doesn't start from scratch each time.
+
+    Only worth it for editors that repaint much less often than they get painted.
+*/
+struct ScaledRasterCache     : public CachedComponentImage
+{
+    explicit ScaledRasterCache (Component& c, int maxScalesIn = 3)
+        : owner (c), maxScales (jmax (1, maxScalesIn)) {}
+
+    void paint (Graphics& g) override
+    {
+        const auto scale      = g.getInternalContext().getPhysicalPixelScaleFactor();
+        const auto compBounds = owner.getLocalBounds();
+        const auto imgBounds  = compBounds * scale;
+        auto& raster          = getRaster (scale);
+
+        if (raster.image.isNull() || raster.image.getBounds() != imgBounds)
+        {
+            raster.image = Image (owner.isOpaque() ? Image::RGB : Image::ARGB,
+                                  jmax (1, imgBounds.getWidth()), jmax (1, imgBounds.getHeight()),
+                                  ! owner.isOpaque());
+            raster.validArea.clear();
+        }
+
+        if (! raster.validArea.containsRectangle (compBounds))
+        {
+            Graphics imG (raster.image);
+            auto& lg = imG.getInternalContext();
+            lg.addTransform (AffineTransform::scale (scale));
+
+            for (const auto& r : raster.validArea)
+                lg.excludeClipRectangle (r);
+
+            if (! owner.isOpaque())
             {
-                auto grid = layout(editor.get());
+                lg.setFill (Colours::transparentBlack);
+                lg.fillRect (compBounds, true);
+                lg.setFill (Colours::black);
+            }
+
+            owner.paintEntireComponent (imG, true);
+            raster.validArea = compBounds;
+            ++numRasterisations;
+        }
 
-                for (const auto& item : grid.items)
-                    if (item.associatedComponent != editor.get())
-                        if (auto comp = item.associatedComponent; !comp->isVisible()) 
-                                addAndMakeVisible(comp);
+        g.setColour (Colours::black.withAlpha (owner.getAlpha()));
+        g.drawImageTransformed (raster.image,
+                                AffineTransform::scale ((float) compBounds.getWidth()  / (float) imgBounds.getWidth(),
+                                                        (float) compBounds.getHeight() / (float) imgBounds.getHeight()),
+                                false);
+    }
 
-                auto [w, h] = calculateGridComponentSizes(grid);
+    bool invalidateAll() override
+    {
+        for (auto& r : rasters)
+            r.validArea.clear();
 
-                setSize((w + size.getWidth()), (h + size.getHeight()));
-                grid.performLayout(getBounds());
+        return true;
+    }
+
+    bool invalidate (const Rectangle<int>& area) override
+    {
+        for (auto& r : rasters)
+            r.validArea.subtract (area);
+
+        return true;
+    }
+
+    void releaseResources() override        { rasters.clear(); }
+
+    /** How many times the component's actually been painted into a raster. */
+    int getNumRasterisations() const noexcept   { return numRasterisations; }
+
+private:
+    struct Raster
+    {
+        float               scale = 1.0f;
+        Image               image;
+        RectangleList<int>  validArea;
+        uint32              lastUsed = 0;
+    };
+
+    Raster& getRaster (float scale)
+    {
+        ++useCounter;
+
+        for (auto& r : rasters)
+        {
+            if (approximatelyEqual (r.scale, scale))
+            {
+                r.lastUsed = useCounter;
+                return r;
             }
         }
+
+        // out of room - recycle whichever scale was used least recently
+        if ((int) rasters.size() >= maxScales)
+        {
+            auto oldest = std::min_element (rasters.begin(), rasters.end(),
+                                            [] (const Raster& a, const Raster& b) { return a.lastUsed < b.lastUsed; });
+            *oldest = { scale, {}, {}, useCounter };
+            return *oldest;
+        }
+
+        rasters.push_back ({ scale, {}, {}, useCounter });
+        return rasters.back();
+    }
+
+    Component&              owner;
+    const int               maxScales;
+    std::vector<Raster>     rasters;
+    uint32                  useCounter = 0;
+    int                     numRasterisations = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ScaledRasterCache)
+};
+
+
+
+//==============================================================================
+/** Hosts a plugin editor, optionally surrounded by other components laid out in a
+    Grid around it (e.g. the standalone app's settings bar and keyboard).
+
+    The Grid is only built when the layout function changes, not on every resize,
+    and bursts of editor resizes (e.g. while dragging a corner) are coalesced into
+    a single layout pass on the message thread.
+*/
+struct PluginEditorComponent     : public Component,
+                                   private AsyncUpdater
+{  
+    using ProcEditor   = std::unique_ptr<AudioProcessorEditor>;
+    using GridLayouFn  = std::function<Grid(Component*)>;
+
+    PluginEditorComponent(ProcEditor editorIn, GridLayouFn layoutIn = nullptr)
+    : editor (std::move (editorIn)), layout (std::move (layoutIn))
+    {
+        addAndMakeVisible (editor.get());
+        rebuildGrid();
+        performLayout();
+    }
+
+    ~PluginEditorComponent() override
+    {
+        cancelPendingUpdate();
+    }
+
+    void childBoundsChanged (Component* child) override
+    {
+        // our own layout pass moves the editor too, which doesn't need another pass
+        if (child != editor.get() || isLayingOut) 
+            return;
+
+        triggerAsyncUpdate();
     }
 
     void setScaleFactor (float scale)
@@ -53,13 +356,98 @@ struct PluginEditorComponent     : public Component
             editor->setScaleFactor (scale);
     }
 
+    /** Opt-in: keeps a raster of the editor for each scale factor it's painted at, so
+        it's only re-rendered when it repaints itself or the scale changes. See
+        ScaledRasterCache.
+    */
+    void setRasterCacheEnabled (bool shouldCache)
+    {
+        if (editor == nullptr || shouldCache == (rasterCache != nullptr))
+            return;
+
+        rasterCache = shouldCache ? new ScaledRasterCache (*editor) : nullptr;
+        editor->setCachedComponentImage (rasterCache);
+    }
+
+    /** Null unless setRasterCacheEnabled (true) has been called. */
+    ScaledRasterCache* getRasterCache() const noexcept  { return rasterCache; }
+
+    /** Shared by everything in the window - children can find it with
+        findParentComponentOfClass<PluginEditorComponent>().
+    */
+    RepaintScheduler& getRepaintScheduler() noexcept    { return repaintScheduler; }
+
+    void paint (Graphics&) override                     { repaintScheduler.beginPaint(); }
+    void paintOverChildren (Graphics&) override         { repaintScheduler.endPaint(); }
+
     void setLayout (GridLayouFn func)
     {
         layout = std::move (func);
-        childBoundsChanged (editor.get());
+        rebuildGrid();
+
+        cancelPendingUpdate();
+        performLayout();
     }
 
+    //==============================================================================
+    int getNumLayoutPasses() const noexcept         { return numLayoutPasses; }
+    double getLastLayoutTimeMs() const noexcept     { return lastLayoutTimeMs; }
+
 private:
+    void handleAsyncUpdate() override   { performLayout(); }
+
+    void rebuildGrid()
+    {
+        if (! layout)
+        {
+            grid.reset();
+            return;
+        }
+
+        grid = layout (editor.get());
+
+        for (const auto& item : grid->items)
+            if (auto comp = item.associatedComponent; comp != nullptr && comp != editor.get())
+                if (! comp->isVisible()) 
+                    addAndMakeVisible (comp);
+
+        fixedSize = calculateGridComponentSizes (*grid);
+        lastEditorBounds = {};
+    }
+
+    void performLayout()
+    {
+        auto size = editor.get()->getBounds();
+
+        // nothing about the editor's changed since last time, so nothing else will have
+        if (size == lastEditorBounds)
+            return;
+
+        const ScopedValueSetter<bool> svs (isLayingOut, true);
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        lastEditorBounds = size;
+
+        if (! grid)
+        {
+            setSize(size.getWidth(), size.getHeight());
+        }
+        else
+        {
+            auto [w, h] = fixedSize;
+
+            // Component::setBounds is a no-op for anything the grid doesn't actually
+            // move, so only the components that change get resized or repainted.
+            setSize((w + size.getWidth()), (h + size.getHeight()));
+            grid->performLayout(getLocalBounds());
+
+            lastEditorBounds = editor.get()->getBounds();
+        }
+
+        ++numLayoutPasses;
+        lastLayoutTimeMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    }
+
     float getTotalAbsoluteSize (const Array<Grid::TrackInfo>& tracks, Grid::Px gapSize) noexcept
     {
         float totalCellSize = 0.0f;
@@ -79,8 +467,56 @@ private:
                     getTotalAbsoluteSize(grid.templateRows, grid.rowGap) };
     }
 
+    // before the editor, which can be using it until it's deleted
+    RepaintScheduler        repaintScheduler;
+
     ProcEditor  editor;
     GridLayouFn layout;
+
+    ScaledRasterCache*      rasterCache = nullptr;      // owned by the editor
+    std::optional<Grid>     grid;
+    std::pair<int, int>     fixedSize;
+    Rectangle<int>          lastEditorBounds;
+    bool                    isLayingOut = false;
+    int                     numLayoutPasses = 0;
+    double                  lastLayoutTimeMs = 0.0;
+};
+
+
+
+//==============================================================================
+/** Put on a component (it takes the place of a CachedComponentImage) so that its
+    repaints - including the ones a JUCE widget makes on its own - go through the
+    RepaintScheduler of the PluginEditorComponent it's in, rather than straight to
+    the window. Anywhere else, it repaints as usual.
+
+        button.setCachedComponentImage (new ScheduledRepaints (button));
+*/
+struct ScheduledRepaints     : public CachedComponentImage
+{
+    explicit ScheduledRepaints (Component& c) : owner (c) {}
+
+    void paint (Graphics& g) override       { owner.paintEntireComponent (g, false); }
+    bool invalidateAll() override           { return invalidate (owner.getLocalBounds()); }
+
+    bool invalidate (const Rectangle<int>& area) override
+    {
+        auto* holder = owner.findParentComponentOfClass<PluginEditorComponent>();
+
+        if (holder == nullptr || holder->getRepaintScheduler().isFlushing())
+            return true;
+
+        // returning false stops the repaint here - the scheduler sends it on next frame
+        holder->getRepaintScheduler().markDirty (owner, area);
+        return false;
+    }
+
+    void releaseResources() override        {}
+
+private:
+    Component& owner;
+
+    JUCE_DECLARE_NON_COPYABLE (ScheduledRepaints)
 };
 
 
@@ -0,0 +1,176 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+//==============================================================================
+/** Lock-free load, overrun and xrun counters for an audio callback.
+
+    The audio thread is the only writer (through addCallback), so every counter is a
+    relaxed atomic that any other thread can read at any time without getting in
+    the way. reset() just asks the audio thread to clear everything on its next go.
+
+    - load is the callback's wall time as a proportion of the buffer period, so
+      anything over 1.0 is an overrun.
+    - jitter is how far the gap between consecutive device host times strayed from
+      the previous buffer's period, and a gap of more than 1.5 periods counts as an
+      xrun (the device dropped or repeated a buffer).
+*/
+class CallbackStats
+{
+public:
+    static constexpr int    numLoadBins         = 41;       // 5% each, the last catches anything over 200%
+    static constexpr double loadBinWidth        = 0.05;
+    static constexpr int    numJitterBins       = 65;       // 100us each, the last catches anything over 6.4ms
+    static constexpr double jitterBinWidthMs    = 0.1;
+
+    struct Snapshot
+    {
+        uint64_t    numCallbacks = 0, numOverruns = 0, numXruns = 0;
+        double      currentLoad = 0, maxLoad = 0, maxJitterMs = 0;
+
+        std::array<uint32_t, (size_t) numLoadBins>      loadHistogram {};
+        std::array<uint32_t, (size_t) numJitterBins>    jitterHistogram {};
+    };
+
+    //==============================================================================
+    /** Audio thread only. */
+    void addCallback (double elapsedSeconds, int numSamples, double sampleRate,
+                      Optional<uint64_t> hostTimeNs) noexcept
+    {
+        if (resetPending.exchange (false))
+            clear();
+
+        if (numSamples <= 0 || sampleRate <= 0)
+            return;
+
+        const auto periodSeconds = numSamples / sampleRate;
+        const auto load          = elapsedSeconds / periodSeconds;
+
+        increment (numCallbacks);
+
+        if (load > 1.0)
+            increment (numOverruns);
+
+        if (load > maxLoad.load (std::memory_order_relaxed))
+            maxLoad.store (load, std::memory_order_relaxed);
+
+        // smoothed a little, so a meter polling this doesn't flicker
+        const auto smoothed = currentLoad.load (std::memory_order_relaxed);
+        currentLoad.store (smoothed + (load - smoothed) * 0.1, std::memory_order_relaxed);
+
+        increment (loadHistogram[(size_t) jlimit (0, numLoadBins - 1, (int) (load / loadBinWidth))]);
+
+        if (hostTimeNs.hasValue())
+        {
+            if (lastHostTimeNs != 0 && *hostTimeNs > lastHostTimeNs)
+            {
+                const auto gapMs      = (double) (*hostTimeNs - lastHostTimeNs) * 1.0e-6;
+                const auto expectedMs = lastPeriodSeconds * 1.0e3;
+                const auto jitterMs   = std::abs (gapMs - expectedMs);
+
+                if (gapMs > expectedMs * 1.5)
+                    increment (numXruns);
+
+                if (jitterMs > maxJitterMs.load (std::memory_order_relaxed))
+                    maxJitterMs.store (jitterMs, std::memory_order_relaxed);
+
+                increment (jitterHistogram[(size_t) jlimit (0, numJitterBins - 1, (int) (jitterMs / jitterBinWidthMs))]);
+            }
+
+            lastHostTimeNs    = *hostTimeNs;
+            lastPeriodSeconds = periodSeconds;
+        }
+    }
+
+    //==============================================================================
+    void reset() noexcept                               { resetPending.store (true); }
+
+    double getCurrentLoad() const noexcept              { return currentLoad.load (std::memory_order_relaxed); }
+    uint64_t getNumOverruns() const noexcept            { return numOverruns.load (std::memory_order_relaxed); }
+    uint64_t getNumXruns() const noexcept               { return numXruns.load (std::memory_order_relaxed); }
+
+    Snapshot getSnapshot() const noexcept
+    {
+        Snapshot s;
+        s.numCallbacks  = numCallbacks.load (std::memory_order_relaxed);
+        s.numOverruns   = numOverruns.load (std::memory_order_relaxed);
+        s.numXruns      = numXruns.load (std::memory_order_relaxed);
+        s.currentLoad   = currentLoad.load (std::memory_order_relaxed);
+        s.maxLoad       = maxLoad.load (std::memory_order_relaxed);
+        s.maxJitterMs   = maxJitterMs.load (std::memory_order_relaxed);
+
+        for (size_t i = 0; i < loadHistogram.size(); ++i)
+            s.loadHistogram[i] = loadHistogram[i].load (std::memory_order_relaxed);
+
+        for (size_t i = 0; i < jitterHistogram.size(); ++i)
+            s.jitterHistogram[i] = jitterHistogram[i].load (std::memory_order_relaxed);
+
+        return s;
+    }
+
+    /** Writes a snapshot out as JSON, e.g. for comparing buffer sizes offline. */
+    bool writeToFile (const File& file) const
+    {
+        const auto s = getSnapshot();
+        auto* obj = new DynamicObject();
+
+        const auto toArray = [] (const auto& histogram)
+        {
+            Array<var> bins;
+
+            for (auto count : histogram)
+                bins.add ((int64) count);
+
+            return bins;
+        };
+
+        obj->setProperty ("numCallbacks",       (int64) s.numCallbacks);
+        obj->setProperty ("numOverruns",        (int64) s.numOverruns);
+        obj->setProperty ("numXruns",           (int64) s.numXruns);
+        obj->setProperty ("currentLoad",        s.currentLoad);
+        obj->setProperty ("maxLoad",            s.maxLoad);
+        obj->setProperty ("maxJitterMs",        s.maxJitterMs);
+        obj->setProperty ("loadBinWidth",       loadBinWidth);
+        obj->setProperty ("loadHistogram",      toArray (s.loadHistogram));
+        obj->setProperty ("jitterBinWidthMs",   jitterBinWidthMs);
+        obj->setProperty ("jitterHistogram",    toArray (s.jitterHistogram));
+
+        return file.replaceWithText (JSON::toString (var (obj)));
+    }
+
+private:
+    //==============================================================================
+    template <typename Counter>
+    static void increment (std::atomic<Counter>& counter) noexcept
+    {
+        // single writer, so there's no need for a read-modify-write
+        counter.store (counter.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void clear() noexcept
+    {
+        numCallbacks.store (0, std::memory_order_relaxed);
+        numOverruns.store (0, std::memory_order_relaxed);
+        numXruns.store (0, std::memory_order_relaxed);
+        currentLoad.store (0, std::memory_order_relaxed);
+        maxLoad.store (0, std::memory_order_relaxed);
+        maxJitterMs.store (0, std::memory_order_relaxed);
+
+        for (auto& bin : loadHistogram)     bin.store (0, std::memory_order_relaxed);
+        for (auto& bin : jitterHistogram)   bin.store (0, std::memory_order_relaxed);
+
+        lastHostTimeNs = 0;
+    }
+
+    //==============================================================================
+    std::atomic<uint64_t>           numCallbacks { 0 }, numOverruns { 0 }, numXruns { 0 };
+    std::atomic<double>             currentLoad { 0 }, maxLoad { 0 }, maxJitterMs { 0 };
+    std::atomic<bool>               resetPending { false };
+
+    std::array<std::atomic<uint32_t>, (size_t) numLoadBins>     loadHistogram {};
+    std::array<std::atomic<uint32_t>, (size_t) numJitterBins>   jitterHistogram {};
+
+    // audio thread only
+    uint64_t                        lastHostTimeNs = 0;
+    double                          lastPeriodSeconds = 0;
+};
@@ -0,0 +1,414 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+//==============================================================================
+/** Plays an audio file into the processor's inputs in place of the device's, so a
+    load test gets the same input every time without a loopback cable.
+
+    A read-ahead thread decodes the file (streamed from disk, or straight out of a
+    memory-mapped WAV) into a ring of fixed-size blocks, which are handed to the
+    audio thread through an AbstractFifo. The audio thread only ever copies out of
+    blocks that are already in memory - it never touches the disk, takes a lock or
+    waits for the reader.
+
+    Seeking is driven by the position the audio thread asks for. Whenever that isn't
+    where the last read left off (the transport was moved), the audio thread bumps a
+    generation counter and flushes the ring, and the reader starts again from the new
+    position. Blocks are tagged with the generation they were read for, so anything
+    that was in flight for the old position is thrown away rather than played. Until
+    the reader catches up the input is silent, so cue the position while the
+    transport's stopped if the first block matters.
+
+    The transport's loop doesn't go through that. The reader keeps the first
+    loopHeadSize samples from the loop start read into a separate buffer, and when a
+    jump lands inside it the audio thread plays from there while the ring is
+    restarted from the end of it - so looping round is heard as a continuation,
+    not a seek.
+*/
+class FileInputSource  : private Thread
+{
+public:
+    static constexpr int blockSize = 4096;  // samples in each block of the ring
+    static constexpr int numBlocks = 32;    // i.e. a little under 3 seconds at 48k
+    static constexpr int loopHeadSize = 3 * blockSize;  // the ring's plenty of time to refill from the end of it
+
+    FileInputSource() : Thread ("File Input Read-Ahead") {}
+
+    ~FileInputSource() override
+    {
+        stopThread (2000);
+    }
+
+    //==============================================================================
+    /** Opens the file and starts reading ahead from the beginning. WAV files can be
+        memory-mapped, which saves the reader a copy through a file stream - anything
+        else (or a WAV that can't be mapped) is streamed. Message thread, and only once.
+    */
+    Result open (const File& file, bool useMemoryMapping)
+    {
+        jassert (reader == nullptr);
+
+        if (useMemoryMapping && file.hasFileExtension ("wav"))
+        {
+            WavAudioFormat wav;
+            std::unique_ptr<MemoryMappedAudioFormatReader> mapped (wav.createMemoryMappedReader (file));
+
+            if (mapped != nullptr && mapped->mapEntireFile())
+            {
+                reader = std::move (mapped);
+                isMapped = true;
+            }
+        }
+
+        if (reader == nullptr)
+        {
+            AudioFormatManager formats;
+            formats.registerBasicFormats();
+            reader.reset (formats.createReaderFor (file));
+        }
+
+        if (reader == nullptr)
+            return Result::fail ("Couldn't open " + file.getFullPathName() + " as an audio file");
+
+        if (reader->lengthInSamples <= 0 || reader->numChannels == 0)
+            return Result::fail (file.getFullPathName() + " doesn't contain any audio");
+
+        for (auto& block : blocks)
+            block.audio.setSize ((int) reader->numChannels, blockSize);
+
+        loopHead.setSize ((int) reader->numChannels, loopHeadSize);
+
+        startThread (Priority::high);
+        return Result::ok();
+    }
+
+    double getSampleRate() const noexcept                   { return reader != nullptr ? reader->sampleRate : 0.0; }
+    int64 getLengthInSamples() const noexcept               { return reader != nullptr ? reader->lengthInSamples : 0; }
+    bool isMemoryMapped() const noexcept                    { return isMapped; }
+
+    /** When this is on (the default), the file repeats for as long as the transport
+        runs. Otherwise it's silent once the position goes past the end. Any thread.
+    */
+    void setLooping (bool shouldLoop) noexcept              { looping.store (shouldLoop); }
+
+    /** How many reads came up short because the reader hadn't got there yet (not
+        counting the first read after a seek), and how many samples were lost to them.
+        Any thread.
+    */
+    int getNumUnderruns() const noexcept                    { return underruns.load (std::memory_order_relaxed); }
+    int64 getNumSamplesMissed() const noexcept              { return samplesMissed.load (std::memory_order_relaxed); }
+    int getNumSeeks() const noexcept                        { return seeks.load (std::memory_order_relaxed); }
+
+    /** Audio thread. Where the transport will land (in samples, at the file's rate)
+        when it next loops round, or nothing if it isn't looping, so the reader can
+        have the audio from there ready before it's asked for.
+    */
+    void setLoopStart (Optional<int64> position) noexcept
+    {
+        if (position.hasValue())
+            loopStartRequest.store (*position, std::memory_order_relaxed);
+
+        hasLoopStartRequest.store (position.hasValue(), std::memory_order_release);
+    }
+
+    /** How many blocks of blockSize samples the reader has got ready. Any thread. */
+    int getNumBlocksReady() const noexcept                  { return fifo.getNumReady(); }
+
+    //==============================================================================
+    /** Audio thread. Fills the first numChannels of `dest` with the file from `position`
+        (in samples, at the file's rate) if the transport's playing, or silence if it
+        isn't - in which case the position is cued so the reader's ready when it starts.
+    */
+    void read (AudioBuffer<float>& dest, int numChannels, int64 position, bool isPlaying) noexcept
+    {
+        const auto numSamples = dest.getNumSamples();
+        numChannels = jmin (numChannels, dest.getNumChannels());
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            FloatVectorOperations::clear (dest.getWritePointer (ch), numSamples);
+
+        const auto length    = reader->lengthInSamples;
+        const auto isLooping = looping.load (std::memory_order_relaxed);
+        auto target = isLooping ? ((position % length) + length) % length : position;
+
+        // a jump the loop head covers carries straight on, so isn't treated as a seek
+        const auto seeked = target != nextPosition && ! (isPlaying && startFromLoopHead (target));
+
+        if (seeked)
+            seekTo (target);
+
+        if (! isPlaying)
+            return;
+
+        for (int done = 0; done < numSamples;)
+        {
+            if (target >= length)
+            {
+                if (! isLooping)
+                    break;
+
+                target = 0;
+            }
+
+            if (usingLoopHead)
+            {
+                const auto headOffset = target - loopHeadStart;
+
+                if (headOffset >= 0 && headOffset < loopHeadLength)
+                {
+                    const auto num = (int) jmin ((int64) (numSamples - done), loopHeadLength - headOffset);
+
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        FloatVectorOperations::copy (dest.getWritePointer (ch, done),
+                                                     loopHead.getReadPointer (ch % loopHead.getNumChannels(), (int) headOffset),
+                                                     num);
+
+                    done   += num;
+                    target += num;
+                    continue;
+                }
+
+                // past the end of it, where the ring was restarted from
+                releaseLoopHead();
+            }
+
+            if (fifo.getNumReady() == 0)
+            {
+                if (! seeked)
+                {
+                    underruns.fetch_add (1, std::memory_order_relaxed);
+                    samplesMissed.fetch_add (numSamples - done, std::memory_order_relaxed);
+                }
+
+                // we'll be asking for the next position next time, which won't be where
+                // the reader is, so it'll be sent there
+                break;
+            }
+
+            int start1, size1, start2, size2;
+            fifo.prepareToRead (1, start1, size1, start2, size2);
+            auto& block = blocks[(size_t) start1];
+
+            // left over from before a seek, or (after an underrun) behind where we are now
+            if (block.generation != generation.load (std::memory_order_relaxed)
+                 || block.startPosition + blockOffset != target)
+            {
+                fifo.finishedRead (1);
+                blockOffset = 0;
+
+                if (block.generation == generation.load (std::memory_order_relaxed))
+                    seekTo (target);
+
+                continue;
+            }
+
+            const auto num = (int) jmin ((int64) (numSamples - done), (int64) (block.numSamples - blockOffset));
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                FloatVectorOperations::copy (dest.getWritePointer (ch, done),
+                                             block.audio.getReadPointer (ch % block.audio.getNumChannels(), blockOffset),
+                                             num);
+
+            done        += num;
+            target      += num;
+            blockOffset += num;
+
+            if (blockOffset == block.numSamples)
+            {
+                fifo.finishedRead (1);
+                blockOffset = 0;
+            }
+        }
+
+        // where the next read should carry on from, whether or not this one got everything
+        nextPosition = isLooping ? (((position + numSamples) % length) + length) % length
+                                 : position + numSamples;
+    }
+
+private:
+    //==============================================================================
+    struct Block
+    {
+        AudioBuffer<float>  audio;
+        int64               startPosition = 0;
+        int                 numSamples = 0;
+        uint32              generation = 0;
+    };
+
+    /** Audio thread. Sends the reader to a new position and drops everything it's
+        read so far.
+    */
+    void seekTo (int64 target) noexcept
+    {
+        releaseLoopHead();
+        restartReaderAt (target);
+
+        nextPosition = target;
+        seeks.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void restartReaderAt (int64 position) noexcept
+    {
+        seekTarget.store (position, std::memory_order_relaxed);
+        generation.fetch_add (1, std::memory_order_release);
+        fifo.finishedRead (fifo.getNumReady());
+
+        blockOffset = 0;
+    }
+
+    /** Audio thread. If the loop head has the audio from `target` on, claims it to
+        play from and sends the reader on to the end of it.
+    */
+    bool startFromLoopHead (int64 target) noexcept
+    {
+        if (! usingLoopHead)
+        {
+            int expected = loopHeadReady;
+
+            if (! loopHeadState.compare_exchange_strong (expected, loopHeadInUse, std::memory_order_acquire))
+                return false;
+
+            usingLoopHead = true;
+        }
+
+        if (target < loopHeadStart || target >= loopHeadStart + loopHeadLength)
+        {
+            releaseLoopHead();
+            return false;
+        }
+
+        const auto headEnd = loopHeadStart + loopHeadLength;
+        restartReaderAt (looping.load (std::memory_order_relaxed) && headEnd >= reader->lengthInSamples ? 0 : headEnd);
+
+        nextPosition = target;
+        return true;
+    }
+
+    void releaseLoopHead() noexcept
+    {
+        if (std::exchange (usingLoopHead, false))
+            loopHeadState.store (loopHeadReady, std::memory_order_release);
+    }
+
+    /** Reader thread. (Re)reads the loop head if the loop start's been moved away from
+        it, unless the audio thread's playing from it right now.
+    */
+    void updateLoopHead()
+    {
+        if (! hasLoopStartRequest.load (std::memory_order_acquire))
+            return;
+
+        const auto length = reader->lengthInSamples;
+        auto start = loopStartRequest.load (std::memory_order_relaxed);
+
+        start = looping.load() ? ((start % length) + length) % length : start;
+
+        if (start < 0 || start >= length)
+            return;
+
+        // the wrap can land a sample or so before the start we were given
+        start = jmax ((int64) 0, start - loopHeadLead);
+
+        const auto state = loopHeadState.load (std::memory_order_acquire);
+
+        if (state == loopHeadInUse || (state == loopHeadReady && std::abs (start - loopHeadStart) <= loopHeadLead / 2))
+            return;
+
+        auto expected = state;
+
+        if (! loopHeadState.compare_exchange_strong (expected, loopHeadWriting, std::memory_order_acquire))
+            return;
+
+        loopHeadStart  = start;
+        loopHeadLength = jmin ((int64) loopHeadSize, length - start);
+        reader->read (&loopHead, 0, (int) loopHeadLength, loopHeadStart, true, true);
+
+        loopHeadState.store (loopHeadReady, std::memory_order_release);
+    }
+
+    //==============================================================================
+    void run() override
+    {
+        uint32 readGeneration = generation.load();
+        int64 readPosition = 0;
+        bool reachedEnd = false;
+
+        while (! threadShouldExit())
+        {
+            const auto currentGeneration = generation.load (std::memory_order_acquire);
+
+            if (currentGeneration != readGeneration)
+            {
+                readGeneration = currentGeneration;
+                readPosition   = seekTarget.load (std::memory_order_relaxed);
+                reachedEnd     = false;
+            }
+
+            updateLoopHead();
+
+            if (reachedEnd || fifo.getFreeSpace() == 0)
+            {
+                wait (1);
+                continue;
+            }
+
+            if (readPosition >= reader->lengthInSamples)
+            {
+                if (! looping.load())
+                {
+                    reachedEnd = true;
+                    continue;
+                }
+
+                readPosition = 0;
+            }
+
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite (1, start1, size1, start2, size2);
+            auto& block = blocks[(size_t) start1];
+
+            // blocks stop short at the end of the file, so a loop starts a fresh one
+            const auto num = (int) jmin ((int64) blockSize, reader->lengthInSamples - readPosition);
+
+            reader->read (&block.audio, 0, num, readPosition, true, true);
+            block.startPosition = readPosition;
+            block.numSamples    = num;
+            block.generation    = readGeneration;
+
+            fifo.finishedWrite (1);
+            readPosition += num;
+        }
+    }
+
+    //==============================================================================
+    std::unique_ptr<AudioFormatReader>  reader;
+    bool                                isMapped = false;
+
+    std::array<Block, numBlocks>        blocks;
+    AbstractFifo                        fifo { numBlocks };
+
+    // owned by whichever thread last moved loopHeadState away from loopHeadReady
+    enum { loopHeadEmpty, loopHeadWriting, loopHeadReady, loopHeadInUse };
+    static constexpr int64              loopHeadLead = 16;
+
+    AudioBuffer<float>                  loopHead;
+    int64                               loopHeadStart = 0, loopHeadLength = 0;
+    std::atomic<int>                    loopHeadState { loopHeadEmpty };
+
+    // written by the audio thread, read by the reader
+    std::atomic<uint32>                 generation { 0 };
+    std::atomic<int64>                  seekTarget { 0 };
+    std::atomic<bool>                   looping { true }, hasLoopStartRequest { false };
+    std::atomic<int64>                  loopStartRequest { 0 };
+
+    std::atomic<int>                    underruns { 0 }, seeks { 0 };
+    std::atomic<int64>                  samplesMissed { 0 };
+
+    // audio thread only
+    int64                               nextPosition = 0;
+    int                                 blockOffset = 0;
+    bool                                usingLoopHead = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FileInputSource)
+};
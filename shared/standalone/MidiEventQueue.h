@@ -0,0 +1,119 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+//==============================================================================
+/** A single producer, single consumer queue of timestamped MIDI events, for getting
+    MIDI into the audio callback without the lock MidiMessageCollector takes.
+
+    Events are copied into preallocated slots, so neither side ever allocates. Anything
+    bigger than maxEventSize (i.e. long sysex), or anything pushed while the queue is
+    full, is dropped and counted rather than making either side wait.
+
+    Timestamps are in seconds, on the Time::getMillisecondCounterHiRes() * 0.001 clock
+    that MidiInput uses for incoming messages.
+*/
+class MidiEventQueue
+{
+public:
+    static constexpr int capacity       = 1024;
+    static constexpr int maxEventSize   = 64;
+
+    //==============================================================================
+    /** Producer side - only ever call this from one thread. */
+    bool push (const MidiMessage& message) noexcept
+    {
+        return push (message.getRawData(), message.getRawDataSize(), message.getTimeStamp());
+    }
+
+    bool push (const uint8* data, int numBytes, double timeStamp) noexcept
+    {
+        if (numBytes <= 0 || numBytes > maxEventSize)
+            return drop();
+
+        const auto scope = fifo.write (1);
+
+        if (scope.blockSize1 == 0)
+            return drop();
+
+        auto& event = events[(size_t) scope.startIndex1];
+        event.numBytes  = numBytes;
+        event.timeStamp = timeStamp;
+        std::copy (data, data + numBytes, event.data.begin());
+        return true;
+    }
+
+    //==============================================================================
+    /** Consumer side - moves every waiting event into `buffer`.
+
+        The interval [intervalStart, intervalEnd) is stretched over the block's numSamples,
+        and each event is placed at the matching sample offset. Passing the previous
+        and current block times gives exactly one block of latency, with the spacing
+        between events kept intact rather than everything landing on sample 0.
+    */
+    void popInto (MidiBuffer& buffer, double intervalStart, double intervalEnd, int numSamples) noexcept
+    {
+        const auto length = intervalEnd - intervalStart;
+        const auto scope  = fifo.read (fifo.getNumReady());
+
+        scope.forEach ([&] (int index)
+        {
+            const auto& event = events[(size_t) index];
+            const auto position = length > 0.0 ? roundToInt ((event.timeStamp - intervalStart) / length * numSamples)
+                                               : 0;
+
+            buffer.addEvent (event.data.data(), event.numBytes, jlimit (0, jmax (0, numSamples - 1), position));
+        });
+    }
+
+    /** Consumer side - calls fn (data, numBytes, timeStamp) for each waiting event, oldest
+        first, stopping at the first one that's due later than `until` (which is left
+        in the queue). Returns the number of events popped.
+    */
+    template <typename Fn>
+    int popUntil (double until, Fn&& fn)
+    {
+        int numPopped = 0;
+
+        for (;;)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead (1, start1, size1, start2, size2);
+
+            if (size1 == 0)
+                break;
+
+            const auto& event = events[(size_t) start1];
+
+            if (event.timeStamp > until)
+                break;
+
+            fn (event.data.data(), event.numBytes, event.timeStamp);
+            fifo.finishedRead (1);
+            ++numPopped;
+        }
+
+        return numPopped;
+    }
+
+    int getNumDropped() const noexcept      { return numDropped.load (std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    struct Event
+    {
+        std::array<uint8, (size_t) maxEventSize>  data;
+        int                                       numBytes = 0;
+        double                                    timeStamp = 0;
+    };
+
+    bool drop() noexcept
+    {
+        numDropped.fetch_add (1, std::memory_order_relaxed);
+        return false;
+    }
+
+    AbstractFifo                                fifo { capacity };
+    std::array<Event, (size_t) capacity>        events;
+    std::atomic<int>                            numDropped { 0 };
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "MidiEventQueue.h"
+
+
+//==============================================================================
+/** Sends a processor's MIDI output from its own thread, so the audio callback never
+    has to wait on a driver write.
+
+    The audio thread stamps each event with the time it's due (worked out from its
+    sample position within the block) and pushes it into a preallocated queue. This
+    thread sends events as they fall due, checking roughly once a millisecond.
+*/
+class MidiOutputSender  : private Thread
+{
+public:
+    MidiOutputSender() : Thread ("MIDI Output Sender") {}
+
+    ~MidiOutputSender() override
+    {
+        setOutput (nullptr);
+    }
+
+    /** Message thread. Once this returns, the old output is no longer in use.
+
+        Setting it to nullptr throws away anything that hasn't been sent yet, so it
+        isn't sent late to whatever output's set next.
+    */
+    void setOutput (MidiOutput* newOutput)
+    {
+        if (newOutput != nullptr && ! isThreadRunning())
+        {
+            // a block the audio thread was part way through when the last output was
+            // cleared may have left a few events behind
+            discardQueued();
+            startThread (Priority::high);
+        }
+
+        {
+            const ScopedLock sl (outputLock);
+            output = newOutput;
+        }
+
+        hasOutput.store (newOutput != nullptr);
+
+        if (newOutput == nullptr && isThreadRunning())
+            stopThread (1000);
+
+        // with the thread stopped, we're the only consumer
+        if (newOutput == nullptr)
+            discardQueued();
+    }
+
+    /** Audio thread. Queues up a block's worth of events, the first sample of the block
+        being due at blockTime (seconds, on the getMillisecondCounterHiRes() clock).
+    */
+    void addBlock (const MidiBuffer& midi, double blockTime, double sampleRate) noexcept
+    {
+        if (! hasOutput.load() || sampleRate <= 0.0)
+            return;
+
+        for (const auto metadata : midi)
+            queue.push (metadata.data, metadata.numBytes, blockTime + metadata.samplePosition / sampleRate);
+    }
+
+    int getNumDropped() const noexcept      { return queue.getNumDropped(); }
+
+private:
+    void discardQueued() noexcept
+    {
+        queue.popUntil (std::numeric_limits<double>::max(), [] (const uint8*, int, double) {});
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            {
+                const ScopedLock sl (outputLock);
+                const auto now = Time::getMillisecondCounterHiRes() * 0.001;
+
+                queue.popUntil (now, [this] (const uint8* data, int numBytes, double)
+                {
+                    if (output != nullptr)
+                        output->sendMessageNow (MidiMessage (data, numBytes));
+                });
+            }
+
+            wait (1);
+        }
+    }
+
+    CriticalSection         outputLock;
+    MidiOutput*             output = nullptr;
+    std::atomic<bool>       hasOutput { false };
+    MidiEventQueue          queue;
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+//==============================================================================
+/** Records what the audio callback played to a WAV or FLAC file, without the audio
+    thread ever touching the disk.
+
+    The audio thread copies each block into a preallocated ring (several seconds
+    long) through an AbstractFifo, and a writer thread drains it in big chunks, so
+    the file's written in large sequential writes rather than one per callback. The
+    writer isn't woken by the audio thread (signalling an event can block), it just
+    polls every few milliseconds.
+
+    If the disk stalls for longer than the ring can cover, whole blocks are dropped
+    rather than waited for, and counted - see getNumSamplesDropped().
+*/
+class OutputRecorder  : private Thread
+{
+public:
+    static constexpr int writeChunkSize = 65536;    // samples per write to the file
+    static constexpr int pollIntervalMs = 10;
+
+    OutputRecorder() : Thread ("Output Recorder") {}
+
+    ~OutputRecorder() override
+    {
+        stop();
+    }
+
+    //==============================================================================
+    /** Starts recording to a file, replacing it if it's already there. A .flac file is
+        written as FLAC (at up to 24 bits), anything else as WAV (32 bits is float).
+        Message thread, and only once.
+    */
+    Result start (const File& file, double sampleRateIn, int numChannelsIn,
+                  int bitsPerSample = 24, double bufferSeconds = 10.0)
+    {
+        file.deleteFile();
+
+        auto stream = std::make_unique<FileOutputStream> (file, (size_t) 1 << 20);
+
+        if (stream->failedToOpen())
+            return Result::fail ("Couldn't open " + file.getFullPathName() + " for writing");
+
+        if (file.hasFileExtension ("flac"))
+        {
+            FlacAudioFormat flac;
+            return start (std::move (stream), flac, sampleRateIn, numChannelsIn, jmin (24, bitsPerSample), bufferSeconds);
+        }
+
+        WavAudioFormat wav;
+        return start (std::move (stream), wav, sampleRateIn, numChannelsIn, bitsPerSample, bufferSeconds);
+    }
+
+    /** Starts recording to any stream, in any format that can write it. */
+    Result start (std::unique_ptr<OutputStream> stream, AudioFormat& format, double sampleRateIn,
+                  int numChannelsIn, int bitsPerSample, double bufferSeconds)
+    {
+        jassert (writer == nullptr && sampleRateIn > 0 && numChannelsIn > 0);
+
+        writer.reset (format.createWriterFor (stream.get(), sampleRateIn, (unsigned int) numChannelsIn,
+                                              bitsPerSample, {}, 0));
+
+        if (writer == nullptr)
+            return Result::fail ("Can't write " + String (numChannelsIn) + " channels of "
+                                  + String (bitsPerSample) + " bit " + format.getFormatName()
+                                  + " at " + String (sampleRateIn) + "Hz");
+
+        // the writer owns it now
+        ignoreUnused (stream.release());
+
+        sampleRate  = sampleRateIn;
+        numChannels = numChannelsIn;
+
+        const auto ringSize = jmax (writeChunkSize * 2, roundToInt (sampleRateIn * bufferSeconds));
+        ring.setSize (numChannels, ringSize);
+        fifo.setTotalSize (ringSize);
+
+        recording.store (true);
+        startThread (Priority::normal);
+        return Result::ok();
+    }
+
+    /** Stops taking new audio, writes out whatever's still in the ring and closes the
+        file. The audio thread must be done with push() before this is called, and it
+        can take a while if the disk's slow. Message thread.
+    */
+    void stop()
+    {
+        recording.store (false);
+        stopThread (-1);
+        writer.reset();
+    }
+
+    double getSampleRate() const noexcept                   { return sampleRate; }
+    int getNumChannels() const noexcept                     { return numChannels; }
+
+    /** Samples per channel that have been handed over, written to the file, and
+        dropped because the ring was full. Any thread.
+    */
+    int64 getNumSamplesRecorded() const noexcept            { return samplesRecorded.load (std::memory_order_relaxed); }
+    int64 getNumSamplesWritten() const noexcept             { return samplesWritten.load (std::memory_order_relaxed); }
+    int64 getNumSamplesDropped() const noexcept             { return samplesDropped.load (std::memory_order_relaxed); }
+
+    /** How full the ring's been at worst (0 to 1), and the longest a single write to
+        the file has taken. Any thread.
+    */
+    double getMaxRingUsage() const noexcept                 { return (double) maxReady.load (std::memory_order_relaxed) / jmax (1, fifo.getTotalSize()); }
+    double getLongestWriteMs() const noexcept               { return longestWriteMs.load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Audio thread. Copies a block into the ring, or drops it (and counts it) if
+        there isn't room. Channels past numChannelsIn are recorded as silence.
+    */
+    void push (const float* const* channels, int numChannelsIn, int numSamples) noexcept
+    {
+        if (! recording.load (std::memory_order_relaxed) || numSamples <= 0)
+            return;
+
+        if (fifo.getFreeSpace() < numSamples)
+        {
+            samplesDropped.fetch_add (numSamples, std::memory_order_relaxed);
+            return;
+        }
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (ch < numChannelsIn)
+            {
+                ring.copyFrom (ch, start1, channels[ch], size1);
+
+                if (size2 > 0)
+                    ring.copyFrom (ch, start2, channels[ch] + size1, size2);
+            }
+            else
+            {
+                ring.clear (ch, start1, size1);
+
+                if (size2 > 0)
+                    ring.clear (ch, start2, size2);
+            }
+        }
+
+        fifo.finishedWrite (size1 + size2);
+        samplesRecorded.fetch_add (numSamples, std::memory_order_relaxed);
+
+        const auto ready = fifo.getNumReady();
+
+        if (ready > maxReady.load (std::memory_order_relaxed))
+            maxReady.store (ready, std::memory_order_relaxed);
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (fifo.getNumReady() < writeChunkSize)
+                wait (pollIntervalMs);
+            else
+                writeChunk (writeChunkSize);
+        }
+
+        // stop() has been called, so nothing more is coming in
+        while (fifo.getNumReady() > 0)
+            writeChunk (writeChunkSize);
+    }
+
+    void writeChunk (int maxSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (jmin (maxSamples, fifo.getNumReady()), start1, size1, start2, size2);
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        // straight out of the ring - the writer converts (and for FLAC, encodes) as it goes
+        writer->writeFromAudioSampleBuffer (ring, start1, size1);
+
+        if (size2 > 0)
+            writer->writeFromAudioSampleBuffer (ring, start2, size2);
+
+        const auto elapsedMs = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1000.0;
+
+        if (elapsedMs > longestWriteMs.load (std::memory_order_relaxed))
+            longestWriteMs.store (elapsedMs, std::memory_order_relaxed);
+
+        fifo.finishedRead (size1 + size2);
+        samplesWritten.fetch_add (size1 + size2, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    std::unique_ptr<AudioFormatWriter>  writer;
+    double                              sampleRate = 0;
+    int                                 numChannels = 0;
+
+    AudioBuffer<float>                  ring;
+    AbstractFifo                        fifo { 1 };
+
+    std::atomic<bool>                   recording { false };
+    std::atomic<int64>                  samplesRecorded { 0 }, samplesWritten { 0 }, samplesDropped { 0 };
+    std::atomic<int>                    maxReady { 0 };
+    std::atomic<double>                 longestWriteMs { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OutputRecorder)
+};
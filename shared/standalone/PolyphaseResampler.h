@@ -0,0 +1,202 @@
+#pragma once
+#include <JuceHeader.h>
+#include <numeric>
+
+#include "SampleConversion.h"   // for the TRANSPORT_PLAYER_USE_* SIMD macros
+
+
+//==============================================================================
+/** A streaming polyphase FIR resampler for a fixed rational ratio, e.g. 44.1k to
+    48k (160/147) or 96k to 48k (1/2).
+
+    The prototype is a Kaiser windowed sinc with tapsPerPhase taps per phase, cut off
+    a little below the lower of the two Nyquist frequencies. Each output sample is a
+    single dot product of the newest tapsPerPhase input samples with one phase's
+    coefficients, done four at a time with SSE2 or NEON where available.
+
+    Everything's allocated in prepare(), so process() is safe to call from the audio
+    thread. All channels share the same phase, so they stay sample aligned.
+*/
+class PolyphaseResampler
+{
+public:
+    static constexpr int tapsPerPhase = 32;
+
+    //==============================================================================
+    /** Sets up for a sourceRate -> destRate conversion of up to maxInputSamples per
+        call. Both rates need to be whole numbers of Hz.
+    */
+    void prepare (double sourceRate, double destRate, int numChannelsIn, int maxInputSamples)
+    {
+        const auto source = roundToInt (sourceRate);
+        const auto dest   = roundToInt (destRate);
+
+        jassert (source > 0 && dest > 0);
+        jassert (approximatelyEqual ((double) source, sourceRate) && approximatelyEqual ((double) dest, destRate));
+
+        const auto divisor = std::gcd (source, dest);
+        upFactor   = dest / divisor;
+        downFactor = source / divisor;
+        numChannels = numChannelsIn;
+        maxInput    = jmax (1, maxInputSamples);
+        sourceSampleRate = (double) source;
+
+        buildCoefficients();
+
+        history.setSize (jmax (1, numChannels), tapsPerPhase - 1 + maxInput);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        history.clear();
+        phase = 0;
+        inputIndex = 0;
+    }
+
+    int getNumChannels() const noexcept                             { return numChannels; }
+
+    /** The most output samples a call with numInputSamples can produce. */
+    int getMaxOutputSamples (int numInputSamples) const noexcept
+    {
+        return (int) (((int64) numInputSamples * upFactor) / downFactor) + 2;
+    }
+
+    /** The filter's group delay, in seconds. */
+    double getLatencySeconds() const noexcept
+    {
+        return ((double) (upFactor * tapsPerPhase - 1) * 0.5) / (sourceSampleRate * upFactor);
+    }
+
+    //==============================================================================
+    /** Resamples numInputSamples from the first numChannelsToProcess channels of `input`
+        into `output`, and returns how many output samples were written to each channel
+        (which varies from call to call unless the ratio divides the block size).
+
+        Channels past numChannelsToProcess are left alone, but the phase still moves on,
+        so the count is the same whether or not there's any audio to resample.
+    */
+    int process (const float* const* input, float* const* output, int numChannelsToProcess, int numInputSamples) noexcept
+    {
+        jassert (numInputSamples <= maxInput && numChannelsToProcess <= numChannels);
+        numInputSamples      = jmin (numInputSamples, maxInput);
+        numChannelsToProcess = jmin (numChannelsToProcess, numChannels);
+
+        for (int ch = 0; ch < numChannelsToProcess; ++ch)
+        {
+            auto* buffer = history.getWritePointer (ch);
+            FloatVectorOperations::copy (buffer + tapsPerPhase - 1, input[ch], numInputSamples);
+
+            auto* dest = output[ch];
+            auto p = phase;
+
+            for (auto i = inputIndex; i < numInputSamples;)
+            {
+                *dest++ = dotProduct (buffer + i, coefficients.getReadPointer (0, p * tapsPerPhase));
+                p += downFactor;
+                i += p / upFactor;
+                p %= upFactor;
+            }
+
+            // keep the newest tapsPerPhase - 1 samples for next time
+            std::memmove (buffer, buffer + numInputSamples, sizeof (float) * (size_t) (tapsPerPhase - 1));
+        }
+
+        int numOut = 0;
+
+        for (; inputIndex < numInputSamples; ++numOut)
+        {
+            phase += downFactor;
+            inputIndex += phase / upFactor;
+            phase %= upFactor;
+        }
+
+        inputIndex -= numInputSamples;
+        return numOut;
+    }
+
+private:
+    //==============================================================================
+    void buildCoefficients()
+    {
+        const auto length = upFactor * tapsPerPhase;
+
+        // normalised to the upsampled rate, a little below the lower Nyquist
+        const auto cutoff = 0.5 * 0.9 / (double) jmax (upFactor, downFactor);
+        const auto beta   = 8.0;
+        const auto centre = (length - 1) * 0.5;
+
+        std::vector<double> prototype ((size_t) length);
+        double sum = 0.0;
+
+        for (int n = 0; n < length; ++n)
+        {
+            const auto x      = n - centre;
+            const auto sinc   = approximatelyEqual (x, 0.0) ? 2.0 * cutoff
+                                                            : std::sin (MathConstants<double>::twoPi * cutoff * x) / (MathConstants<double>::pi * x);
+            const auto ratio  = 2.0 * n / (length - 1) - 1.0;
+            const auto window = besselI0 (beta * std::sqrt (jmax (0.0, 1.0 - ratio * ratio))) / besselI0 (beta);
+
+            prototype[(size_t) n] = sinc * window;
+            sum += prototype[(size_t) n];
+        }
+
+        // each phase is laid out oldest sample first, to match the history buffer,
+        // and scaled so the whole filter has a gain of upFactor (i.e. unity per phase)
+        coefficients.setSize (1, length);
+
+        for (int p = 0; p < upFactor; ++p)
+            for (int k = 0; k < tapsPerPhase; ++k)
+                coefficients.setSample (0, p * tapsPerPhase + (tapsPerPhase - 1 - k),
+                                        (float) (prototype[(size_t) (p + k * upFactor)] * upFactor / sum));
+    }
+
+    static double besselI0 (double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 50 && term > sum * 1.0e-12; ++k)
+        {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum  += term;
+        }
+
+        return sum;
+    }
+
+    static float dotProduct (const float* a, const float* b) noexcept
+    {
+        static_assert (tapsPerPhase % 4 == 0, "the SIMD loops assume whole vectors");
+
+       #if TRANSPORT_PLAYER_USE_SSE2
+        auto acc = _mm_setzero_ps();
+
+        for (int i = 0; i < tapsPerPhase; i += 4)
+            acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+
+        acc = _mm_add_ps (acc, _mm_movehl_ps (acc, acc));
+        acc = _mm_add_ss (acc, _mm_shuffle_ps (acc, acc, 1));
+        return _mm_cvtss_f32 (acc);
+       #elif TRANSPORT_PLAYER_USE_NEON64
+        auto acc = vdupq_n_f32 (0.0f);
+
+        for (int i = 0; i < tapsPerPhase; i += 4)
+            acc = vfmaq_f32 (acc, vld1q_f32 (a + i), vld1q_f32 (b + i));
+
+        return vaddvq_f32 (acc);
+       #else
+        float acc = 0.0f;
+
+        for (int i = 0; i < tapsPerPhase; ++i)
+            acc += a[i] * b[i];
+
+        return acc;
+       #endif
+    }
+
+    //==============================================================================
+    int                 upFactor = 1, downFactor = 1, numChannels = 0, maxInput = 1;
+    double              sourceSampleRate = 1.0;
+    AudioBuffer<float>  coefficients, history;
+    int                 phase = 0, inputIndex = 0;
+};
@@ -0,0 +1,480 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ // declared here rather than pulling all of windows.h into every file that includes us
+ struct _SECURITY_ATTRIBUTES;
+ extern "C" __declspec (dllimport) void* __stdcall CreateSemaphoreW (_SECURITY_ATTRIBUTES*, long, long, const wchar_t*);
+ extern "C" __declspec (dllimport) int __stdcall CloseHandle (void*);
+ extern "C" __declspec (dllimport) unsigned long __stdcall WaitForSingleObject (void*, unsigned long);
+ extern "C" __declspec (dllimport) int __stdcall ReleaseSemaphore (void*, long, long*);
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+#endif
+
+#if defined (__SSE2__) || defined (_M_X64) || defined (_M_IX86)
+ #include <emmintrin.h>
+#endif
+
+
+//==============================================================================
+/** A counting semaphore for handing work between realtime threads.
+
+    The count lives in an atomic, and the OS semaphore underneath is only touched when
+    a thread actually has to go to sleep or be woken up - so signalling while nobody's
+    asleep is a single atomic add. Neither side ever takes a lock: waking a sleeper is
+    a futex wake (or the platform's equivalent), which can't be held up by whatever
+    thread it's waking.
+*/
+class RealtimeSemaphore
+{
+public:
+    RealtimeSemaphore()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        semaphore = dispatch_semaphore_create (0);
+       #elif JUCE_WINDOWS
+        semaphore = CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr);
+       #else
+        sem_init (&semaphore, 0, 0);
+       #endif
+    }
+
+    ~RealtimeSemaphore()
+    {
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_release (semaphore);
+       #elif JUCE_WINDOWS
+        CloseHandle (semaphore);
+       #else
+        sem_destroy (&semaphore);
+       #endif
+    }
+
+    /** Lets up to `count` waiting (or future) calls to wait() through. */
+    void signal (int count = 1) noexcept
+    {
+        const auto previous = value.fetch_add (count, std::memory_order_release);
+        const auto numAsleep = jmin (-previous, count);
+
+        if (numAsleep > 0)
+            post (numAsleep);
+    }
+
+    /** Checks for a signal up to numSpins times before going to sleep until one comes. */
+    void wait (int numSpins) noexcept
+    {
+        for (int i = 0; i < numSpins; ++i)
+        {
+            auto current = value.load (std::memory_order_relaxed);
+
+            if (current > 0 && value.compare_exchange_weak (current, current - 1, std::memory_order_acquire,
+                                                                                  std::memory_order_relaxed))
+                return;
+
+            pause();
+        }
+
+        if (value.fetch_sub (1, std::memory_order_acquire) <= 0)
+            sleep();
+    }
+
+    /** Tells the cpu we're spinning, so it can ease off (and let a hyperthread sibling run). */
+    static void pause() noexcept
+    {
+       #if defined (__SSE2__) || defined (_M_X64) || defined (_M_IX86)
+        _mm_pause();
+       #elif defined (__aarch64__) || defined (__arm__)
+        asm volatile ("yield");
+       #endif
+    }
+
+private:
+    void post (int count) noexcept
+    {
+       #if JUCE_MAC || JUCE_IOS
+        while (--count >= 0)
+            dispatch_semaphore_signal (semaphore);
+       #elif JUCE_WINDOWS
+        ReleaseSemaphore (semaphore, count, nullptr);
+       #else
+        while (--count >= 0)
+            sem_post (&semaphore);
+       #endif
+    }
+
+    void sleep() noexcept
+    {
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_wait (semaphore, DISPATCH_TIME_FOREVER);
+       #elif JUCE_WINDOWS
+        WaitForSingleObject (semaphore, 0xffffffff);
+       #else
+        while (sem_wait (&semaphore) != 0 && errno == EINTR) {}
+       #endif
+    }
+
+    // how many signals are waiting to be picked up, or minus how many threads are asleep
+    std::atomic<int>            value { 0 };
+
+   #if JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_t        semaphore;
+   #elif JUCE_WINDOWS
+    void*                       semaphore;
+   #else
+    sem_t                       semaphore;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeSemaphore)
+};
+
+
+//==============================================================================
+/** A fixed pool of high priority threads that help the audio thread get through a
+    batch of independent jobs.
+
+    The calling (audio) thread always runs the first job itself, and the rest are
+    handed out through a single atomic word holding the batch's generation, size and
+    next job - so whichever thread is free next (the audio thread included) claims the
+    next one, slow jobs never hold up the rest, and a worker that's late to a batch
+    can never pick up a job from the one after it.
+
+    Nothing the audio thread does can block on another thread: workers are woken
+    through a RealtimeSemaphore, and once it's run out of jobs to claim the audio
+    thread spins briefly for the last ones to finish before sleeping on another one.
+    Workers spin for a while after each batch too, as the next one is usually only a
+    buffer away.
+
+    Workers are started as realtime threads where the OS allows it, and at the
+    highest normal priority where it doesn't (e.g. a normal user on Linux). Any that
+    can't be started at all are left out, and getNumWorkers() says how many are
+    actually running.
+*/
+class RealtimeWorkerPool
+{
+public:
+    explicit RealtimeWorkerPool (int numWorkers)
+    {
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            auto worker = std::make_unique<Worker> (*this, i);
+
+            if (worker->startRealtimeThread (Thread::RealtimeOptions{}) || worker->startThread (Thread::Priority::highest))
+                workers.push_back (std::move (worker));
+        }
+
+        if (getNumWorkers() < numWorkers)
+            Logger::writeToLog ("RealtimeWorkerPool: only " + String (getNumWorkers()) + " of "
+                                  + String (numWorkers) + " worker threads could be started");
+    }
+
+    ~RealtimeWorkerPool()
+    {
+        for (auto& w : workers)
+            w->signalThreadShouldExit();
+
+        workAvailable.signal (getNumWorkers());
+
+        for (auto& w : workers)
+            w->stopThread (1000);
+    }
+
+    int getNumWorkers() const noexcept                  { return (int) workers.size(); }
+
+    /** Calls fn (index) for every index in [0, numJobs), spread across the workers and
+        the calling thread, and returns once they've all finished. Job 0 always runs on
+        the calling thread. Doesn't allocate or take any locks.
+    */
+    template <typename Fn>
+    void run (int numJobs, Fn& fn)
+    {
+        if (numJobs <= 0)
+            return;
+
+        if (workers.empty() || numJobs == 1)
+        {
+            for (int i = 0; i < numJobs; ++i)
+                fn (i);
+
+            return;
+        }
+
+        jassert (numJobs <= 0xffff);
+
+        jobFn       = [] (void* context, int index) { (*static_cast<Fn*> (context)) (index); };
+        jobContext  = &fn;
+        jobsRemaining.store (numJobs, std::memory_order_relaxed);
+
+        // job 0's ours, so the others start from 1
+        claim.store (makeClaim (++generation, numJobs, 1), std::memory_order_release);
+        workAvailable.signal (jmin (getNumWorkers(), numJobs - 1));
+
+        fn (0);
+        finishJob();
+
+        helpWithBatch();
+        batchDone.wait (numDoneSpins);
+    }
+
+private:
+    //==============================================================================
+    struct Worker   : public Thread
+    {
+        Worker (RealtimeWorkerPool& p, int index)
+            : Thread ("Realtime Worker " + String (index)), pool (p) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                pool.workAvailable.wait (numSpins);
+
+                // a wake-up left over from a batch we'd already helped finish just finds
+                // nothing to claim
+                if (! threadShouldExit())
+                    pool.helpWithBatch();
+            }
+        }
+
+        static constexpr int    numSpins = 20000;
+
+        RealtimeWorkerPool&     pool;
+    };
+
+    //==============================================================================
+    // generation in the top 32 bits, then the number of jobs, then the next one to claim
+    static uint64_t makeClaim (uint32_t generation, int numJobs, int next) noexcept
+    {
+        return ((uint64_t) generation << 32) | ((uint64_t) numJobs << 16) | (uint64_t) next;
+    }
+
+    void helpWithBatch()
+    {
+        auto current = claim.load (std::memory_order_acquire);
+
+        for (;;)
+        {
+            const auto numJobs = (int) ((current >> 16) & 0xffff);
+            const auto index   = (int) (current & 0xffff);
+
+            if (index >= numJobs)
+                return;
+
+            // claiming a job from a batch means that batch can't finish (and the next
+            // one can't replace jobFn) until we've run it
+            if (claim.compare_exchange_weak (current, current + 1, std::memory_order_acq_rel,
+                                                                   std::memory_order_acquire))
+            {
+                jobFn (jobContext, index);
+                finishJob();
+                current = claim.load (std::memory_order_acquire);
+            }
+        }
+    }
+
+    void finishJob() noexcept
+    {
+        if (jobsRemaining.fetch_sub (1, std::memory_order_acq_rel) == 1)
+            batchDone.signal();
+    }
+
+    //==============================================================================
+    static constexpr int                    numDoneSpins = 20000;
+
+    std::vector<std::unique_ptr<Worker>>    workers;
+    RealtimeSemaphore                       workAvailable, batchDone;
+
+    void (*jobFn) (void*, int) = nullptr;
+    void*                                   jobContext = nullptr;
+    std::atomic<uint64_t>                   claim { 0 };
+    std::atomic<int>                        jobsRemaining { 0 };
+    uint32_t                                generation = 0;     // only touched by run()
+};
+
+
+//==============================================================================
+/** Hosts several independent processor chains as a single processor.
+
+    Every chain gets its own copy of the input audio and MIDI, the chains are run in
+    parallel on a RealtimeWorkerPool, and their outputs are summed back together.
+    The audio thread always runs the first chain itself, so it only needs one worker
+    per extra chain. Because it's just an AudioProcessor, the transport player drives it exactly as it
+    would a single plugin instance (playhead, routing and all).
+*/
+class ParallelProcessorGroup  : public AudioProcessor
+{
+public:
+    using Chain = std::vector<std::unique_ptr<AudioProcessor>>;
+
+    ParallelProcessorGroup (std::vector<Chain> chainsIn, int numWorkers)
+        : AudioProcessor (propertiesFor (*chainsIn.front().front())),
+          pool (jmax (0, jmin (numWorkers, (int) chainsIn.size() - 1)))
+    {
+        for (auto& c : chainsIn)
+        {
+            jassert (! c.empty());
+            chains.push_back ({ std::move (c), {}, {} });
+        }
+    }
+
+    //==============================================================================
+    int getNumChains() const noexcept                           { return (int) chains.size(); }
+
+    /** How many worker threads are running alongside the audio thread - which can be
+        fewer than asked for, if the OS wouldn't start them all.
+    */
+    int getNumWorkers() const noexcept                          { return pool.getNumWorkers(); }
+    AudioProcessor* getProcessor (int chain, int index) const   { return chains[(size_t) chain].processors[(size_t) index].get(); }
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        const auto numIns   = getTotalNumInputChannels();
+        const auto numOuts  = getTotalNumOutputChannels();
+        const auto numChans = jmax (numIns, numOuts);
+
+        for (auto& c : chains)
+        {
+            for (auto& p : c.processors)
+            {
+                p->setPlayConfigDetails (numIns, numOuts, sampleRate, samplesPerBlock);
+                p->setProcessingPrecision (singlePrecision);
+                p->setNonRealtime (isNonRealtime());
+                p->setPlayHead (getPlayHead());
+                p->prepareToPlay (sampleRate, samplesPerBlock);
+            }
+
+            c.buffer.setSize (numChans, samplesPerBlock);
+            c.midi.ensureSize (4096);
+        }
+    }
+
+    void releaseResources() override
+    {
+        for (auto& c : chains)
+            for (auto& p : c.processors)
+                p->releaseResources();
+    }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi) override
+    {
+        const auto numSamples  = buffer.getNumSamples();
+        const auto numChannels = buffer.getNumChannels();
+
+        auto processChain = [&] (int index)
+        {
+            auto& c = chains[(size_t) index];
+            jassert (c.buffer.getNumSamples() >= numSamples);
+
+            AudioBuffer<float> chainBuffer (c.buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                chainBuffer.copyFrom (ch, 0, buffer, ch, 0, numSamples);
+
+            c.midi.clear();
+            c.midi.addEvents (midi, 0, numSamples, 0);
+
+            for (auto& p : c.processors)
+                p->processBlock (chainBuffer, c.midi);
+        };
+
+        pool.run ((int) chains.size(), processChain);
+
+        // the summing bus
+        buffer.clear();
+        midi.clear();
+
+        for (auto& c : chains)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                buffer.addFrom (ch, 0, c.buffer, ch, 0, numSamples);
+
+            midi.addEvents (c.midi, 0, numSamples, 0);
+        }
+    }
+
+    using AudioProcessor::processBlock;
+
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override
+    {
+        for (auto& c : chains)
+            for (auto& p : c.processors)
+                if (! p->checkBusesLayoutSupported (layouts))
+                    return false;
+
+        return true;
+    }
+
+    void setPlayHead (AudioPlayHead* newPlayHead) override
+    {
+        AudioProcessor::setPlayHead (newPlayHead);
+
+        for (auto& c : chains)
+            for (auto& p : c.processors)
+                p->setPlayHead (newPlayHead);
+    }
+
+    //==============================================================================
+    const String getName() const override       { return first().getName() + " x " + String (chains.size()); }
+    bool acceptsMidi() const override           { return first().acceptsMidi(); }
+    bool producesMidi() const override          { return first().producesMidi(); }
+    bool isMidiEffect() const override          { return first().isMidiEffect(); }
+
+    double getTailLengthSeconds() const override
+    {
+        double tail = 0.0;
+
+        for (auto& c : chains)
+            for (auto& p : c.processors)
+                tail = jmax (tail, p->getTailLengthSeconds());
+
+        return tail;
+    }
+
+    bool hasEditor() const override                             { return false; }
+    AudioProcessorEditor* createEditor() override               { return nullptr; }
+
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       {}
+    const String getProgramName (int) override                  { return {}; }
+    void changeProgramName (int, const String&) override        {}
+
+    void getStateInformation (MemoryBlock&) override            {}
+    void setStateInformation (const void*, int) override        {}
+
+private:
+    //==============================================================================
+    struct ChainState
+    {
+        Chain                   processors;
+        AudioBuffer<float>      buffer;
+        MidiBuffer              midi;
+    };
+
+    AudioProcessor& first() const                               { return *chains.front().processors.front(); }
+
+    static BusesProperties propertiesFor (AudioProcessor& proc)
+    {
+        BusesProperties props;
+
+        for (int i = 0; i < proc.getBusCount (true); ++i)
+            if (auto* bus = proc.getBus (true, i))
+                props.addBus (true, bus->getName(), bus->getDefaultLayout(), bus->isEnabledByDefault());
+
+        for (int i = 0; i < proc.getBusCount (false); ++i)
+            if (auto* bus = proc.getBus (false, i))
+                props.addBus (false, bus->getName(), bus->getDefaultLayout(), bus->isEnabledByDefault());
+
+        return props;
+    }
+
+    std::vector<ChainState>     chains;
+    RealtimeWorkerPool          pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParallelProcessorGroup)
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <JuceHeader.h>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define TRANSPORT_PLAYER_USE_SSE2 1
+#elif defined (__aarch64__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define TRANSPORT_PLAYER_USE_NEON64 1
+#endif
+
+
+//==============================================================================
+/** Vectorised float <-> double sample conversion, for running double precision
+    processors on float device buffers without going sample by sample.
+
+    Falls back to a plain loop on platforms without SSE2 or 64-bit NEON, and for
+    whatever's left over after the last full vector.
+*/
+struct SampleConversion
+{
+    static void convert (double* dest, const float* src, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if TRANSPORT_PLAYER_USE_SSE2
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto v = _mm_loadu_ps (src + i);
+            _mm_storeu_pd (dest + i,     _mm_cvtps_pd (v));
+            _mm_storeu_pd (dest + i + 2, _mm_cvtps_pd (_mm_movehl_ps (v, v)));
+        }
+       #elif TRANSPORT_PLAYER_USE_NEON64
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto v = vld1q_f32 (src + i);
+            vst1q_f64 (dest + i,     vcvt_f64_f32 (vget_low_f32 (v)));
+            vst1q_f64 (dest + i + 2, vcvt_high_f64_f32 (v));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = static_cast<double> (src[i]);
+    }
+
+    static void convert (float* dest, const double* src, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if TRANSPORT_PLAYER_USE_SSE2
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto lo = _mm_cvtpd_ps (_mm_loadu_pd (src + i));
+            const auto hi = _mm_cvtpd_ps (_mm_loadu_pd (src + i + 2));
+            _mm_storeu_ps (dest + i, _mm_movelh_ps (lo, hi));
+        }
+       #elif TRANSPORT_PLAYER_USE_NEON64
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const auto lo = vcvt_f32_f64 (vld1q_f64 (src + i));
+            const auto hi = vcvt_f32_f64 (vld1q_f64 (src + i + 2));
+            vst1q_f32 (dest + i, vcombine_f32 (lo, hi));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = static_cast<float> (src[i]);
+    }
+};
@@ -2,13 +2,16 @@
 #include <JuceHeader.h>
 
 #include "../PluginEditorComponent.h"
+#include "ProcessorGroup.h"
 #include "TransportPlayer.h"
+#include "VirtualAudioDevice.h"
 
 
 //==================================================================================
 class StandalonePluginInstance
 {
     std::unique_ptr<AudioProcessor>     processor;
+    AudioProcessor*                     editorProcessor = nullptr;
     AudioDeviceManager                  manager;
     MidiKeyboardState                   midiState;
     AudioTransportPlayer                player;
@@ -20,22 +23,74 @@ class StandalonePluginInstance
     }
 
 public:
-    StandalonePluginInstance() 
+    /** With more than one instance, the instances are run side by side in a
+        ParallelProcessorGroup (spread across the cpus), and their outputs summed.
+        The editor always belongs to the first instance.
+
+        With a virtual device, the manager only knows about a VirtualAudioIODevice
+        (with its channel counts taken from the processor), so it runs without any
+        sound hardware.
+    */
+    explicit StandalonePluginInstance (int numInstances = 1,
+                                       const VirtualAudioIODevice::Settings* virtualDevice = nullptr) 
     {
-        processor .reset (getPluginFilter());
-
-        manager.initialiseWithDefaultDevices (processor->getTotalNumInputChannels(), 
-                                              processor->getTotalNumOutputChannels());
+        if (numInstances > 1)
+        {
+            std::vector<ParallelProcessorGroup::Chain> chains ((size_t) numInstances);
+
+            for (auto& chain : chains)
+                chain.emplace_back (createPluginFilter());
+
+            const auto numWorkers = jmin (numInstances, SystemStats::getNumCpus()) - 1;
+            auto group = std::make_unique<ParallelProcessorGroup> (std::move (chains), numWorkers);
+
+            editorProcessor = group->getProcessor (0, 0);
+            processor = std::move (group);
+        }
+        else
+        {
+            processor .reset (getPluginFilter());
+            editorProcessor = processor.get();
+        }
+
+        if (virtualDevice != nullptr)
+        {
+            auto settings = *virtualDevice;
+            settings.numInputChannels  = processor->getTotalNumInputChannels();
+            settings.numOutputChannels = processor->getTotalNumOutputChannels();
+
+            // added before the manager creates the platform's types, so it never does
+            manager.addAudioDeviceType (std::make_unique<VirtualAudioIODeviceType> (settings));
+
+            AudioDeviceManager::AudioDeviceSetup setup;
+            setup.outputDeviceName = VirtualAudioIODeviceType::deviceName;
+            setup.inputDeviceName  = VirtualAudioIODeviceType::deviceName;
+            setup.sampleRate       = settings.sampleRate;
+            setup.bufferSize       = settings.bufferSize;
+
+            manager.initialise (settings.numInputChannels, settings.numOutputChannels, nullptr, false, {}, &setup);
+        }
+        else
+        {
+            manager.initialiseWithDefaultDevices (processor->getTotalNumInputChannels(), 
+                                                  processor->getTotalNumOutputChannels());
+        }
         manager.addAudioCallback (&player);
+        manager.addMidiInputDeviceCallback ({}, &player);
+        midiState.addListener (&player);
     }
     
     ~StandalonePluginInstance() 
     {
         stopPlaying();
 
-        processor->editorBeingDeleted (getActiveEditor());
+        // there's no editor in a soak run
+        if (auto* ed = editorProcessor->getActiveEditor())
+            editorProcessor->editorBeingDeleted (ed);
         processor.reset (nullptr);
 
+        midiState.removeListener (&player);
+        manager.removeMidiInputDeviceCallback ({}, &player);
 		manager.removeAudioCallback(&player);
 		manager.closeAudioDevice();
     }
@@ -92,15 +147,21 @@ public:
     MidiKeyboardState& getMidiState()                { return midiState; }
     void SetBPM(double bpm)
     {
-        // player sets this thread safely, using a lock, though...
+        // the player picks this up on the next block, no locking involved
         player.setBPM(bpm);
     }
+
+    AudioTransportPlayer::PlayHead& getTransport()   { return player.getPlayHead(); }
+    CallbackStats& getCallbackStats()                { return player.getCallbackStats(); }
+
+    /** The device that's running, if it's a virtual one. */
+    VirtualAudioIODevice* getVirtualDevice()         { return dynamic_cast<VirtualAudioIODevice*> (manager.getCurrentAudioDevice()); }
     
 
     //==============================================================================
     AudioProcessorEditor* createEditor() const
     {
-        auto ed = processor->hasEditor() ? processor->createEditorIfNeeded() 
+        auto ed = editorProcessor->hasEditor() ? editorProcessor->createEditorIfNeeded() 
                                          : nullptr;
         jassert (ed != nullptr);
         return ed;
@@ -109,13 +170,117 @@ public:
     AudioProcessorEditor* getActiveEditor() const
     {
         // MessageManagerLock mmLock; // locking here seems to get rid of the bad access error?
-        auto ed = processor->getActiveEditor(); // check with breakpoint here...?
+        auto ed = editorProcessor->getActiveEditor(); // check with breakpoint here...?
         jassert (ed != nullptr);
         return ed;
     }
 };
 
 
+//==================================================================================
+/** A compact callback load and xrun readout for the window's header row. The load
+    is the time spent in the callback as a share of the buffer period, not the
+    process's CPU usage. Click it to save the full stats (histograms and all) to a
+    JSON file.
+
+    It's polled by the window's RepaintScheduler, and only repaints when what it
+    shows has changed.
+*/
+class CallbackLoadMeter     : public Component
+{
+    struct Reading
+    {
+        int     percent = -1;
+        int64   xruns = 0, overruns = 0;
+
+        bool operator!= (const Reading& other) const noexcept
+        {
+            return percent != other.percent || xruns != other.xruns || overruns != other.overruns;
+        }
+    };
+
+    CallbackStats&                  stats;
+    std::unique_ptr<FileChooser>    chooser;
+    RepaintScheduler*               scheduler = nullptr;
+    Reading                         shown;
+
+    Reading read() const
+    {
+        return { roundToInt (stats.getCurrentLoad() * 100.0), (int64) stats.getNumXruns(), (int64) stats.getNumOverruns() };
+    }
+
+    void poll()
+    {
+        if (read() != shown)
+            scheduler->markDirty (*this);
+    }
+
+public:
+    explicit CallbackLoadMeter (CallbackStats& statsIn) : stats (statsIn) {}
+
+    ~CallbackLoadMeter() override
+    {
+        if (scheduler != nullptr)
+            scheduler->removePoll (*this);
+    }
+
+    void parentHierarchyChanged() override
+    {
+        auto* holder = findParentComponentOfClass<PluginEditorComponent>();
+        auto* next   = holder != nullptr ? &holder->getRepaintScheduler() : nullptr;
+
+        if (next == scheduler)
+            return;
+
+        if (scheduler != nullptr)
+            scheduler->removePoll (*this);
+
+        scheduler = next;
+
+        if (scheduler != nullptr)
+            scheduler->addPoll (*this, [this] { poll(); });
+    }
+
+    void paint (Graphics& g) override
+    {
+        shown = read();
+
+        const auto load   = shown.percent / 100.0;
+        const auto bounds = getLocalBounds().toFloat().reduced (2.0f);
+        const auto filled = bounds.withWidth (bounds.getWidth() * (float) jlimit (0.0, 1.0, load));
+
+        g.setColour (findColour (ResizableWindow::backgroundColourId).darker());
+        g.fillRoundedRectangle (bounds, 3.0f);
+
+        g.setColour (load < 0.7 ? Colours::green : load < 0.9 ? Colours::orange : Colours::red);
+        g.fillRoundedRectangle (filled, 3.0f);
+
+        g.setColour (Colours::white);
+        g.setFont (12.0f);
+        g.drawFittedText (String (shown.percent) + "% of callback budget, "
+                            + String (shown.xruns) + " xruns, "
+                            + String (shown.overruns) + " overruns",
+                          getLocalBounds(), Justification::centred, 1);
+    }
+
+    void mouseUp (const MouseEvent&) override
+    {
+        auto defaultFile = File::getSpecialLocation (File::userDocumentsDirectory)
+                               .getChildFile ("callback-stats.json");
+
+        chooser = std::make_unique<FileChooser> (translate("Save Callback Stats"), defaultFile, "*.json");
+        chooser->launchAsync (FileBrowserComponent::saveMode 
+                                | FileBrowserComponent::canSelectFiles 
+                                | FileBrowserComponent::warnAboutOverwriting,
+                              [this] (const FileChooser& fc)
+                              {
+                                  if (auto file = fc.getResult(); file != File())
+                                      stats.writeToFile (file);
+                              });
+    }
+};
+
+
 extern juce::JUCEApplicationBase* juce_CreateApplication();
 
 //==================================================================================
@@ -126,13 +291,16 @@ class StandaloneFilterApp   : public JUCEApplication
     std::unique_ptr<ScaledDocumentWindow>           pluginWindow;
 
     std::unique_ptr<juce::MidiKeyboardComponent>    midiKeyboard;
+    std::unique_ptr<CallbackLoadMeter>              loadMeter;
     juce::TextButton                                settingsButton  { translate("Audio/MIDI Settings") };
+    juce::TextButton                                playButton      { translate("Stop") };
     juce::Slider                                    tempoSlider     { Slider::LinearBar, Slider::TextBoxLeft };
 
     //==============================================================================
     void cleanUp()
     {
         midiKeyboard.reset (nullptr);
+        loadMeter.reset (nullptr);
         pluginProcessor.reset (nullptr);
         editorComponent.reset (nullptr);
         pluginWindow.reset (nullptr);
@@ -157,16 +325,82 @@ public:
     void anotherInstanceStarted (const String&) override    {}
 
     //==============================================================================
-    void initialise (const String&) override
+    void initialise (const String& commandLine) override
     {
-        pluginProcessor.reset (new StandalonePluginInstance());
+        // e.g. --instances=4 to run four copies of the plugin side by side
+        const ArgumentList args ({}, StringArray::fromTokens (commandLine, true));
+        const auto numInstances = jmax (1, args.getValueForOption ("--instances").getIntValue());
+
+        // e.g. --virtual-device --sample-rate=96000 --buffer-size=64 on a machine with no
+        // sound hardware, and --soak-seconds=3600 --stats-output=soak.json to run for an
+        // hour without a window, then write out the callback stats (and the device's,
+        // next to them) and quit
+        if (args.containsOption ("--virtual-device"))
+        {
+            VirtualAudioIODevice::Settings settings;
+
+            if (args.containsOption ("--sample-rate"))
+                settings.sampleRate = args.getValueForOption ("--sample-rate").getDoubleValue();
+
+            if (args.containsOption ("--buffer-size"))
+                settings.bufferSize = args.getValueForOption ("--buffer-size").getIntValue();
+
+            pluginProcessor.reset (new StandalonePluginInstance (numInstances, &settings));
+        }
+        else
+        {
+            pluginProcessor.reset (new StandalonePluginInstance (numInstances));
+        }
+
+        if (args.containsOption ("--soak-seconds"))
+        {
+            const auto soakMs     = roundToInt (args.getValueForOption ("--soak-seconds").getDoubleValue() * 1000.0);
+            const auto statsFile  = args.containsOption ("--stats-output")
+                                        ? File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--stats-output"))
+                                        : File();
+
+            Timer::callAfterDelay (soakMs, [this, statsFile]
+            {
+                if (pluginProcessor != nullptr && statsFile != File())
+                {
+                    pluginProcessor->getCallbackStats().writeToFile (statsFile);
+
+                    if (auto* device = pluginProcessor->getVirtualDevice())
+                        device->writeToFile (statsFile.getSiblingFile (statsFile.getFileNameWithoutExtension() + "-device.json"));
+                }
+
+                quit();
+            });
+
+            // a soak is usually run on a headless CI agent, so there's no window at all -
+            // just the player, the soak timer and the stats it writes out
+            pluginProcessor->startPlaying();
+            return;
+        }
 
         midiKeyboard.reset (new MidiKeyboardComponent (pluginProcessor->getMidiState(), 
                                                         MidiKeyboardComponent::horizontalKeyboard));
 
+        loadMeter.reset (new CallbackLoadMeter (pluginProcessor->getCallbackStats()));
+
+        // the widgets' own repaints are flushed along with everything else in the window
+        for (auto* widget : { static_cast<Component*> (midiKeyboard.get()), static_cast<Component*> (&tempoSlider),
+                              static_cast<Component*> (&settingsButton), static_cast<Component*> (&playButton) })
+            widget->setCachedComponentImage (new ScheduledRepaints (*widget));
+
         settingsButton.onClick = [&] () { pluginProcessor->showAudioDeviceSettingsDialog(); };
 
-        tempoSlider.setRange (0.0, 500.0, 0.01);
+        playButton.onClick = [&] ()
+        {
+            auto& transport = pluginProcessor->getTransport();
+
+            if (transport.isPlaying()) transport.stop();
+            else                       transport.play();
+
+            playButton.setButtonText (transport.isPlaying() ? translate("Stop") : translate("Play"));
+        };
+
+        tempoSlider.setRange (1.0, 500.0, 0.01);
         tempoSlider.setValue (120.0);
         tempoSlider.setSkewFactorFromMidPoint (120.0);
         tempoSlider.setTextValueSuffix(" BPM");
@@ -183,14 +417,16 @@ public:
                 using Tr = Grid::TrackInfo; 
                 juce::Grid grid;
 
-                grid.templateColumns     = { Tr (05_fr), Tr (05_fr) };
+                grid.templateColumns     = { Tr (05_fr), Tr (02_fr), Tr (04_fr), Tr (05_fr) };
                 grid.templateRows        = { Tr (25_px), Tr (1_fr), Tr (60_px) };
                 
-                grid.templateAreas       = { "HeaderOne HeaderTwo",
-                                             "Main Main",
-                                             "Footer Footer" };
+                grid.templateAreas       = { "HeaderOne Transport Meter HeaderTwo",
+                                             "Main Main Main Main",
+                                             "Footer Footer Footer Footer" };
 
                 grid.items = {  GridItem(settingsButton).withArea ("HeaderOne"),
+                                GridItem(playButton).withArea ("Transport"),
+                                GridItem(loadMeter.get()).withArea ("Meter"),
                                 GridItem(tempoSlider).withArea ("HeaderTwo"),
                                 GridItem(editor).withArea ("Main"),
                                 GridItem(midiKeyboard.get()).withArea ("Footer"), };
@@ -1,290 +1,1609 @@
 #pragma once
 #include <JuceHeader.h>
 
+#include "CallbackStats.h"
+#include "FileInputSource.h"
+#include "MidiEventQueue.h"
+#include "MidiOutputSender.h"
+#include "OutputRecorder.h"
+#include "PolyphaseResampler.h"
+#include "SampleConversion.h"
+
 
 //==============================================================================
 class AudioTransportPlayer  : public AudioIODeviceCallback,
-                              public MidiInputCallback
+                              public MidiInputCallback,
+                              public MidiKeyboardState::Listener
 {
 public:
     template <typename Value>
     struct ChannelInfo
     {
-        ChannelInfo() = default;
-        ChannelInfo (Value* const* dataIn, int numChannelsIn)
-            : data (dataIn), numChannels (numChannelsIn)  {}
+        ChannelInfo() = default;
+        ChannelInfo (Value* const* dataIn, int numChannelsIn)
+            : data (dataIn), numChannels (numChannelsIn)  {}
+
+        Value* const*       data = nullptr;
+        int                 numChannels = 0;
+    };
+
+    struct NumChannels
+    {
+        NumChannels() = default;
+        NumChannels (int numIns, int numOuts) : ins (numIns), outs (numOuts) {}
+
+        explicit NumChannels (const AudioProcessor::BusesLayout& layout)
+            : ins (layout.getNumChannels (true, 0)), outs (layout.getNumChannels (false, 0)) {}
+
+        AudioProcessor::BusesLayout toLayout() const
+        {
+            return { { AudioChannelSet::canonicalChannelSet (ins) },
+                     { AudioChannelSet::canonicalChannelSet (outs) } };
+        }
+
+        bool operator== (const NumChannels& other) const noexcept   { return ins == other.ins && outs == other.outs; }
+        bool operator!= (const NumChannels& other) const noexcept   { return ! operator== (other); }
+
+        int ins = 0, outs = 0;
+    };
+
+    /** Where one of the processor's channels gets its data from, and where it lives. */
+    struct ChannelRoute
+    {
+        int input  = -1;    // system input to copy from, or -1 to zero the channel
+        int output = -1;    // system output to process in place, or -1 for a temp channel
+    };
+
+    /** A musical transport for the processor to follow.
+
+        The transport controls (play, stop, tempo, time signature, looping and seeking)
+        can be called from any thread, and are picked up by the audio thread at the start
+        of the next block. The position is moved on incrementally from the last point
+        the tempo changed, so it stays continuous across tempo changes and doesn't drift
+        however long it runs for.
+
+        There's no tempo or time signature map - seeking assumes the current tempo and
+        signature apply from the start of the timeline.
+    */
+    struct PlayHead : public AudioPlayHead
+    {
+        PlayHead() = default;
+
+        //==============================================================================
+        void play()                                         { playing.store (true); }
+        void stop()                                         { playing.store (false); }
+        bool isPlaying() const noexcept                     { return playing.load(); }
+
+        void setBpm (double newBpm)
+        {
+            jassert (newBpm > 0.0);
+
+            if (newBpm > 0.0)
+                bpm.store (newBpm);
+        }
+
+        double getBpm() const noexcept                      { return bpm.load(); }
+
+        void setTimeSignature (int numerator, int denominator)
+        {
+            const auto isValid = numerator > 0 && numerator < 0x10000 && denominator > 0 && denominator < 0x10000;
+            jassert (isValid);
+
+            // a zero would leave the bar length zero (or the packing garbled), so it's ignored
+            if (isValid)
+                timeSignature.store (((uint32_t) numerator << 16) | (uint32_t) denominator);
+        }
+
+        void setLooping (bool shouldLoop)                   { looping.store (shouldLoop); }
+
+        void setLoopPoints (double startPpq, double endPpq)
+        {
+            jassert (endPpq > startPpq);
+
+            // odd while we're writing, so the audio thread never sees half an update
+            ++loopVersion;
+            loopStart.store (startPpq);
+            loopEnd.store (endPpq);
+            ++loopVersion;
+        }
+
+        /** Moves the transport to a position in quarter notes. */
+        void setPosition (double ppq)
+        {
+            seekTarget.store (ppq);
+            seekPending.store (true);
+        }
+
+        //==============================================================================
+        /** Called by the player once per block before the processor runs, on the audio
+            thread. Publishes the position at the start of the block, then moves the
+            transport on by numSamples if it's playing.
+        */
+        void advance (Optional<uint64_t> hostTimeIn, int numSamples, double sampleRateIn)
+        {
+            jassert (sampleRateIn > 0.0);
+
+            pullControls (sampleRateIn);
+
+            info.setHostTimeNs (hostTimeIn);
+            info.setBpm (currentBpm);
+            info.setTimeSignature (currentSignature);
+            info.setIsPlaying (isRunning);
+            info.setIsLooping (isLooping);
+            info.setLoopPoints (loopPoints);
+            info.setTimeInSamples (timeInSamples);
+            info.setTimeInSeconds ((double) timeInSamples / sampleRateIn);
+            info.setPpqPosition (ppq);
+            info.setPpqPositionOfLastBarStart (barStartPpq);
+            info.setBarCount (barCount);
+
+            // the wrap lands up to a block past this, give or take a sample of rounding
+            loopStartInSamples = isLooping && ppq < loopPoints.ppqEnd
+                                    ? makeOptional (timeInSamples + (int64_t) std::llround ((loopPoints.ppqStart - ppq) * samplesPerQuarter))
+                                    : nullopt;
+
+            if (isRunning)
+                moveForward (numSamples);
+        }
+
+        Optional<PositionInfo> getPosition() const override { return info; }
+        PositionInfo info;
+
+        /** Roughly where timeInSamples will jump back to when the transport next wraps
+            round the loop, or nothing if it won't (it isn't looping, or it's already
+            past the loop's end). As of the last advance(), so audio thread only.
+        */
+        Optional<int64_t> getLoopStartInSamples() const noexcept    { return loopStartInSamples; }
+
+    private:
+        //==============================================================================
+        void pullControls (double sampleRateIn)
+        {
+            const auto newBpm = bpm.load();
+
+            if (newBpm != currentBpm || sampleRateIn != currentSampleRate)
+            {
+                currentBpm          = newBpm;
+                currentSampleRate   = sampleRateIn;
+                samplesPerQuarter   = (60.0 / currentBpm) * currentSampleRate;
+                reanchor();
+            }
+
+            const auto packed = timeSignature.load();
+            const TimeSignature newSignature { (int) (packed >> 16), (int) (packed & 0xffff) };
+
+            if (newSignature != currentSignature)
+            {
+                // the new signature starts from the bar we're currently in
+                signatureAnchorPpq = barStartPpq;
+                signatureAnchorBar = barCount;
+                currentSignature   = newSignature;
+            }
+
+            const auto version = loopVersion.load();
+
+            if ((version & 1u) == 0 && version != lastLoopVersion)
+            {
+                const LoopPoints newLoop { loopStart.load(), loopEnd.load() };
+
+                // if it changed again while we were reading, we'll catch it next block
+                if (loopVersion.load() == version)
+                {
+                    loopPoints      = newLoop;
+                    lastLoopVersion = version;
+                }
+            }
+
+            isRunning = playing.load();
+            isLooping = looping.load() && loopPoints.ppqEnd > loopPoints.ppqStart;
+
+            if (seekPending.exchange (false))
+            {
+                ppq                 = seekTarget.load();
+                timeInSamples       = (int64_t) std::llround (ppq * samplesPerQuarter);
+                signatureAnchorPpq  = 0.0;
+                signatureAnchorBar  = 0;
+                reanchor();
+            }
+
+            updateBarPosition();
+        }
+
+        void moveForward (int numSamples)
+        {
+            const auto previousPpq = ppq;
+
+            samplesSinceAnchor += numSamples;
+            timeInSamples      += numSamples;
+            ppq = anchorPpq + (double) samplesSinceAnchor / samplesPerQuarter;
+
+            // only wrap if we actually crossed the loop end, so enabling a loop
+            // while we're already past it doesn't throw us backwards
+            if (isLooping && previousPpq < loopPoints.ppqEnd && ppq >= loopPoints.ppqEnd)
+            {
+                const auto loopLength = loopPoints.ppqEnd - loopPoints.ppqStart;
+
+                ppq = loopPoints.ppqStart + std::fmod (ppq - loopPoints.ppqEnd, loopLength);
+                timeInSamples -= (int64_t) std::llround (loopLength * samplesPerQuarter);
+                reanchor();
+            }
+
+            updateBarPosition();
+        }
+
+        void reanchor() noexcept
+        {
+            anchorPpq          = ppq;
+            samplesSinceAnchor = 0;
+        }
+
+        void updateBarPosition() noexcept
+        {
+            const auto quarterNotesPerBar = currentSignature.numerator * 4.0 / currentSignature.denominator;
+            const auto barsSinceAnchor    = std::floor ((ppq - signatureAnchorPpq) / quarterNotesPerBar);
+
+            barStartPpq = signatureAnchorPpq + barsSinceAnchor * quarterNotesPerBar;
+            barCount    = signatureAnchorBar + (int64_t) barsSinceAnchor;
+        }
+
+        //==============================================================================
+        // written from any thread
+        std::atomic<double>             bpm { 120.0 };
+        std::atomic<uint32_t>           timeSignature { (4u << 16) | 4u };
+        std::atomic<bool>               playing { true }, looping { false }, seekPending { false };
+        std::atomic<double>             loopStart { 0.0 }, loopEnd { 16.0 }, seekTarget { 0.0 };
+        std::atomic<uint32_t>           loopVersion { 0 };
+
+        // audio thread only
+        double                          currentBpm = 0.0, currentSampleRate = 0.0, samplesPerQuarter = 1.0;
+        TimeSignature                   currentSignature;
+        LoopPoints                      loopPoints { 0.0, 16.0 };
+        uint32_t                        lastLoopVersion = 0;
+        bool                            isRunning = false, isLooping = false;
+
+        double                          ppq = 0.0, anchorPpq = 0.0, barStartPpq = 0.0, signatureAnchorPpq = 0.0;
+        int64_t                         samplesSinceAnchor = 0, timeInSamples = 0;
+        int64_t                         barCount = 0, signatureAnchorBar = 0;
+        Optional<int64_t>               loopStartInSamples;
+    };
+
+    struct CallbackState;
+
+    /** A crossfade from one state to the one that replaced it. It's shared between the
+        incoming state and the thread waiting for the fade to finish, so either one can
+        go away first.
+    */
+    struct Fade
+    {
+        // owned by the fade - whoever takes it out (see endFade()) retires it
+        std::atomic<CallbackState*>     outgoing { nullptr };
+        int                             length = 0;
+        std::atomic<int>                remaining { 0 };
+        std::atomic<bool>               abandoned { false };
+    };
+
+    /** Everything the audio callback needs to run a processor.
+
+        A state is built and fully allocated on the calling (message) thread, then
+        published to the audio thread with a single atomic exchange. Once published
+        only the audio thread touches it (and only its scratch buffers), and the
+        previous state is only freed (and its processor released) after the audio
+        thread is guaranteed to have stopped looking at it.
+    */
+    struct CallbackState
+    {
+        AudioProcessor*            processor = nullptr;
+        NumChannels                processorChannels;
+        double                     sampleRate = 0;          // the rate the processor runs at
+        double                     deviceSampleRate = 0;
+        int                        blockSize = 0;           // the most processAtStateRate() is handed
+        int                        processorBlockSize = 0;  // what the processor was prepared for
+        bool                       isPrepared = false,
+                                   preparedDoublePrecision = false,
+                                   preparedNonRealtime = false;
+
+        std::vector<ChannelRoute>  routes;
+        std::vector<float*>        channels, subBlockChannels;
+        AudioBuffer<float>         tempBuffer;
+        AudioBuffer<double>        conversionBuffer;
+
+        // the crossfade from the state this one replaced, if any - see setProcessorAsync()
+        std::shared_ptr<Fade>      fade;
+        AudioBuffer<float>         fadeBuffer;
+        MidiBuffer                 fadeMidi;
+
+        // the fixed block size adaptor, if it's on - see setFixedBlockSize()
+        int                        fixedBlockSize = 0;
+        AudioBuffer<float>         fixedBuffers[2];     // one filling, one being played out
+        MidiBuffer                 fixedMidi, fixedPlayingMidi, fixedOutputMidi;
+        int                        fixedFilling = 0, fixedPosition = 0;
+
+        // the resamplers either side of the processor, if it's running at a fixed
+        // internal rate - see setInternalSampleRate()
+        bool                       isResampling = false;
+        PolyphaseResampler         inputResampler, outputResampler;
+        AudioBuffer<float>         internalIns, internalOuts, outputFifo;
+        std::vector<float*>        internalInChannels, internalOutChannels, fifoChannels;
+        int                        fifoCount = 0;
+        MidiBuffer                 resampledMidi;
+
+        // replaces the device input, if it's set - see setInputFile(). It's swapped in
+        // place, without rebuilding the state.
+        std::atomic<FileInputSource*> fileInput { nullptr };
+
+        // gets a copy of everything sent to the device, if it's set - see startRecording().
+        // Swapped in place, like the input file.
+        std::atomic<OutputRecorder*> recorder { nullptr };
+    };
+
+    //==============================================================================
+    AudioTransportPlayer (bool doDoublePrecisionProcessing = false) 
+        : isDoublePrecision (doDoublePrecisionProcessing) 
+    {
+        incomingMidi.ensureSize (4096);
+        subBlockMidi.ensureSize (4096);
+        outgoingMidi.ensureSize (4096);
+    }
+
+    ~AudioTransportPlayer() override 
+    {
+        preparePool.removeAllJobs (false, 10000);
+        setProcessor (nullptr);
+        retireState (publishState (nullptr));
+    }
+
+    void setBPM (double bpm)
+    {
+        // read once per block by the audio thread, so no lock needed
+        playHead.setBpm (bpm);
+    }
+
+    double getBPM() const noexcept                                  { return playHead.getBpm(); }
+
+    /** The transport the processor follows - its controls are safe to call from any thread. */
+    PlayHead& getPlayHead() noexcept                                { return playHead; }
+
+    /** Per-callback load, overrun and xrun counters - safe to read from any thread.
+        They're reset whenever a device starts, and only count the device's callbacks
+        unless setOfflineRendersCounted (true) has been called.
+    */
+    CallbackStats& getCallbackStats() noexcept                      { return stats; }
+
+    /** Whether blocks rendered with renderOffline() go into the callback stats too, e.g.
+        for a benchmark pacing an offline render like a device. Off by default, so a
+        faster than realtime render doesn't look like a string of overloaded callbacks.
+        Safe to call from any thread.
+    */
+    void setOfflineRendersCounted (bool shouldCount) noexcept       { countOfflineRenders.store (shouldCount); }
+
+    //==============================================================================
+    void setProcessor (AudioProcessor* processorToPlay)
+    {
+        const ScopedLock sl (lock);
+
+        if (processor == processorToPlay)
+            return;
+
+        installProcessor (processorToPlay);
+    }
+
+    /** Prepares processorToPlay on a background thread and then swaps it in, so that
+        a slow prepareToPlay never stalls the audio (or the caller).
+
+        If crossfadeMs is more than zero, the outgoing processor keeps running for
+        that long after the swap and is faded out as the new one fades in. The old
+        processor is released on the background thread once it's finished with, and
+        onSwapped (if given) is then called on the message thread.
+    */
+    void setProcessorAsync (AudioProcessor* processorToPlay, double crossfadeMs = 0.0,
+                            std::function<void()> onSwapped = nullptr)
+    {
+        preparePool.addJob ([this, processorToPlay, crossfadeMs, onSwapped]
+        {
+            std::shared_ptr<Fade> fade;
+
+            {
+                const ScopedLock sl (lock);
+
+                if (processor != processorToPlay)
+                    fade = installProcessor (processorToPlay, crossfadeMs);
+            }
+
+            // the lock's free while the fade runs, so nothing else has to wait for it
+            if (fade != nullptr)
+                finishFade (*fade, crossfadeMs);
+
+            if (onSwapped != nullptr)
+                MessageManager::callAsync (onSwapped);
+        });
+    }
+
+    AudioProcessor* getCurrentProcessor() const
+    {
+        const ScopedLock sl (lock);
+        return processor;
+    }
+
+    /** The processor's MIDI output is sent from a separate thread (see MidiOutputSender),
+        so once this returns the old output is no longer in use and can be deleted.
+    */
+    void setMidiOutput (MidiOutput* midiOutputToUse)
+    {
+        midiSender.setOutput (midiOutputToUse);
+    }
+
+    void setDoublePrecisionProcessing (bool doublePrecision)
+    {
+        const ScopedLock sl (lock);
+
+        if (doublePrecision != isDoublePrecision)
+        {
+            isDoublePrecision = doublePrecision;
+
+            if (processor != nullptr)
+                installProcessor (processor);
+        }
+    }
+
+    inline bool getDoublePrecisionProcessing() { return isDoublePrecision; }
+
+    /** When this is more than zero, each block is cut into sub-blocks at the times of
+        its MIDI events, and the processor is run (with the playhead moved on) once per
+        sub-block - so a processor that only reacts at the start of a block still lands
+        every event on the right sample. No sub-block is made shorter than
+        minSubBlockSamples, which bounds the overhead when events are dense.
+
+        Zero (the default) runs one block per callback. Safe to call from any thread.
+    */
+    void setSubBlockSplitting (int minSubBlockSamples) noexcept
+    {
+        jassert (minSubBlockSamples >= 0);
+        minSubBlockSize.store (jmax (0, minSubBlockSamples));
+    }
+
+    int getSubBlockSplitting() const noexcept                       { return minSubBlockSize.load(); }
+
+    /** When this is more than zero, the processor is prepared for and always handed
+        blocks of exactly this many samples, whatever size the device's buffers are
+        (e.g. for FFT processing that wants a fixed power of two).
+
+        Device audio is gathered into one preallocated buffer while the previous block
+        the processor produced is played out of another, which delays the output by
+        exactly newBlockSize samples - see getAddedLatencySamples(). Hot-swaps don't
+        crossfade while it's on. Zero (the default) turns it off.
+    */
+    void setFixedBlockSize (int newBlockSize)
+    {
+        jassert (newBlockSize >= 0);
+
+        const ScopedLock sl (lock);
+
+        if (jmax (0, newBlockSize) == fixedBlockSize)
+            return;
+
+        fixedBlockSize = jmax (0, newBlockSize);
+        installProcessor (processor);
+    }
+
+    int getFixedBlockSize() const
+    {
+        const ScopedLock sl (lock);
+        return fixedBlockSize;
+    }
+
+    /** When this is more than zero, the processor is always prepared at and run at this
+        sample rate, whatever rate the device is running at. The device audio (and MIDI
+        timing) is converted to the internal rate before processBlock and back again
+        after it by a pair of polyphase resamplers, so the processor never has to cope
+        with a rate it wasn't tuned for.
+
+        The rates have to be whole numbers of Hz. The resamplers' filter delay is added
+        to getAddedLatencySamples(), and hot-swaps don't crossfade while they're in use.
+        While the processor's rate and block size don't need to change, a device change
+        carries on with the processor as it was prepared rather than preparing it again.
+        Zero (the default) runs the processor at the device's rate.
+    */
+    void setInternalSampleRate (double newSampleRate)
+    {
+        jassert (newSampleRate >= 0);
+
+        const ScopedLock sl (lock);
+
+        if (approximatelyEqual (jmax (0.0, newSampleRate), internalSampleRate))
+            return;
+
+        internalSampleRate = jmax (0.0, newSampleRate);
+        installProcessor (processor);
+    }
+
+    double getInternalSampleRate() const
+    {
+        const ScopedLock sl (lock);
+        return internalSampleRate;
+    }
+
+    /** Feeds the processor's inputs from an audio file instead of the device's inputs,
+        following the playhead - it plays from the playhead's position while the
+        transport runs, loops round with it, and is silent while it's stopped. See
+        FileInputSource for how it's read.
+
+        The file has to be at the rate the processor runs at (see setInternalSampleRate()),
+        otherwise it's ignored and the device's inputs are used. Message thread.
+    */
+    Result setInputFile (const File& file, bool useMemoryMapping = true)
+    {
+        auto source = std::make_unique<FileInputSource>();
+        const auto result = source->open (file, useMemoryMapping);
+
+        if (result.wasOk())
+            swapInputFile (std::move (source));
+
+        return result;
+    }
+
+    /** Goes back to the device's inputs. Message thread. */
+    void clearInputFile()                                           { swapInputFile (nullptr); }
+
+    /** The current input file, e.g. for its looping and underrun counts. It's deleted
+        by the next setInputFile() or clearInputFile(). Message thread.
+    */
+    FileInputSource* getInputFile() const noexcept                  { return fileInput.get(); }
+
+    /** Starts recording everything the player sends to the device (or renders offline)
+        to a WAV or FLAC file, from the next block on. See OutputRecorder for how it's
+        written. Nothing's recorded while the device's rate or number of outputs is
+        different from when it started. Message thread.
+    */
+    Result startRecording (const File& file, int bitsPerSample = 24)
+    {
+        double rate;
+        int numOuts;
+
+        {
+            const ScopedLock sl (lock);
+            rate    = sampleRate;
+            numOuts = deviceChannels.outs;
+        }
+
+        if (rate <= 0 || numOuts <= 0)
+            return Result::fail ("There's no device running to record");
+
+        auto newRecorder = std::make_unique<OutputRecorder>();
+        const auto result = newRecorder->start (file, rate, numOuts, bitsPerSample);
+
+        if (result.wasOk())
+            startRecording (std::move (newRecorder));
+
+        return result;
+    }
+
+    /** Records into a recorder that's already been started, e.g. to write to a stream of
+        your own. Its rate and number of channels have to match the device's.
+    */
+    void startRecording (std::unique_ptr<OutputRecorder> startedRecorder)
+    {
+        swapRecorder (std::move (startedRecorder));
+    }
+
+    /** Stops recording, and finishes writing the file. This waits for whatever's still
+        buffered to go to disk. Message thread.
+    */
+    void stopRecording()                                            { swapRecorder (nullptr); }
+
+    bool isRecording() const                                        { const ScopedLock sl (lock); return recorder != nullptr; }
+
+    /** The current recording, e.g. for its dropped sample count. It's deleted by the
+        next startRecording() or stopRecording(). Message thread.
+    */
+    OutputRecorder* getRecorder() const noexcept                    { return recorder.get(); }
+
+    /** How many samples (at the device's rate) the player itself delays the processor's
+        output by, on top of the processor's own getLatencySamples(). This covers the
+        fixed block size adaptor and the internal rate resamplers. Safe to call from
+        any thread.
+    */
+    int getAddedLatencySamples() const noexcept                     { return addedLatency.load(); }
+
+    /** The player's added latency plus whatever the processor reports (converted to the
+        device's rate). Not for the audio thread, as it takes the lock.
+    */
+    int getTotalLatencySamples() const
+    {
+        const ScopedLock sl (lock);
+
+        if (processor == nullptr)
+            return addedLatency.load();
+
+        const auto processorLatency = isResamplingFor (sampleRate)
+                                        ? roundToInt (processor->getLatencySamples() * sampleRate / internalSampleRate)
+                                        : processor->getLatencySamples();
+
+        return addedLatency.load() + processorLatency;
+    }
+
+    //==============================================================================
+    void audioDeviceIOCallbackWithContext (const float* const* const inputChannelData,
+                                            const int numInputChannels,
+                                            float* const* const outputChannelData,
+                                            const int numOutputChannels,
+                                            const int numSamples,
+                                            const AudioIODeviceCallbackContext& context) override
+    {
+        renderNextBlock (inputChannelData, 
+                         numInputChannels, 
+                         outputChannelData, 
+                         numOutputChannels, 
+                         numSamples,
+                         context.hostTimeNs != nullptr ? makeOptional (*context.hostTimeNs) : nullopt,
+                         true);
+    }
+
+    //==============================================================================
+    /** Prepares the player to be driven by renderOffline() instead of an audio device,
+        so that a session can be rendered as fast as the CPU allows (e.g. on a machine
+        with no sound hardware).
+
+        The processor is prepared exactly as it would be for a device with this sample
+        rate, block size and channel layout, and is told it's running non-realtime.
+        The player mustn't be attached to a running device while rendering offline.
+    */
+    void prepareOfflineRender (double newSampleRate, int newBlockSize, NumChannels layout)
+    {
+        jassert (newSampleRate > 0 && newBlockSize > 0);
+
+        const ScopedLock sl (lock);
+
+        sampleRate          = newSampleRate;
+        blockSize           = newBlockSize;
+        deviceChannels      = layout;
+        isRenderingOffline  = true;
+
+        offlineIns .resize ((size_t) layout.ins);
+        offlineOuts.resize ((size_t) layout.outs);
+
+        installProcessor (processor);
+    }
+
+    /** Renders numSamples of the processor's output into `output`, starting at startSample.
+
+        The input is read from the same region of `input`, or silence is used if it's null.
+        If `midi` is given, its events (with positions relative to startSample) are fed
+        to the processor alongside anything arriving from devices. If `midiOutput` is
+        given, the processor's MIDI output is added to it, relative to startSample too.
+        The render is chopped into blocks no larger than the prepared block size, and goes
+        through exactly the same PlayHead, MIDI and double precision paths as the device
+        callback. Call this from the thread that called prepareOfflineRender().
+    */
+    void renderOffline (const AudioBuffer<float>* input, AudioBuffer<float>& output, 
+                        int startSample, int numSamples, const MidiBuffer* midi = nullptr,
+                        MidiBuffer* midiOutput = nullptr)
+    {
+        jassert (isRenderingOffline);
+        jassert (output.getNumChannels() >= deviceChannels.outs);
+        jassert (startSample >= 0 && startSample + numSamples <= output.getNumSamples());
+
+        const auto numIns  = input != nullptr ? jmin (input->getNumChannels(), deviceChannels.ins) : 0;
+        const auto numOuts = deviceChannels.outs;
+
+        for (int done = 0; done < numSamples;)
+        {
+            const auto num    = jmin (blockSize, numSamples - done);
+            const auto offset = startSample + done;
+
+            for (int i = 0; i < numIns; ++i)
+                offlineIns[(size_t) i] = input->getReadPointer (i, offset);
+
+            for (int i = 0; i < numOuts; ++i)
+                offlineOuts[(size_t) i] = output.getWritePointer (i, offset);
+
+            offlineMidi       = midi;
+            offlineMidiOutput = midiOutput;
+            offlineMidiOffset = done;
+
+            renderNextBlock (offlineIns.data(), numIns, offlineOuts.data(), numOuts, num, nullopt,
+                             countOfflineRenders.load());
+            done += num;
+        }
+
+        offlineMidi       = nullptr;
+        offlineMidiOutput = nullptr;
+    }
+
+    /** Ends an offline render, releasing the processor's resources. */
+    void releaseOfflineRender()
+    {
+        const ScopedLock sl (lock);
+
+        retireState (publishState (nullptr));
+
+        if (processor != nullptr)
+            processor->setNonRealtime (false);
+
+        sampleRate          = 0.0;
+        blockSize           = 0;
+        isRenderingOffline  = false;
+    }
+
+    bool isOffline() const noexcept                                 { return isRenderingOffline; }
+
+    //==============================================================================
+    void audioDeviceAboutToStart (AudioIODevice* device) override
+    {
+        auto newSampleRate  = device->getCurrentSampleRate();
+        auto newBlockSize   = device->getCurrentBufferSizeSamples();
+        auto numChansIn     = device->getActiveInputChannels().countNumberOfSetBits();
+        auto numChansOut    = device->getActiveOutputChannels().countNumberOfSetBits();
+
+        const ScopedLock sl (lock);
+
+        sampleRate          = newSampleRate;
+        blockSize           = newBlockSize;
+        deviceChannels      = {numChansIn, numChansOut};
+
+        // a new device (or new settings) starts the stats from scratch
+        stats.reset();
+
+        // re-prepares the current processor (if any, and if it needs it) for the new device settings
+        installProcessor (processor);
+    }
+
+    void audioDeviceStopped() override
+    {
+        const ScopedLock sl (lock);
+
+        retireState (publishState (nullptr));
+
+        sampleRate          = 0.0;
+        blockSize           = 0;
+    }
+
+    /** Called on the MIDI input thread - the message's timestamp is used to place it
+        within the block it ends up in.
+    */
+    void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message) override
+    {
+        deviceMidi.push (message);
+    }
+
+    /** Attach us to a MidiKeyboardState (with addListener) to play the processor from an
+        on-screen keyboard. Keyboard events have to come from a single thread, which
+        will normally be the message thread.
+    */
+    void handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        auto message = MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity);
+        keyboardMidi.push (message.getRawData(), message.getRawDataSize(), Time::getMillisecondCounterHiRes() * 0.001);
+    }
+
+    void handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        auto message = MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity);
+        keyboardMidi.push (message.getRawData(), message.getRawDataSize(), Time::getMillisecondCounterHiRes() * 0.001);
+    }
+
+private:
+    //==============================================================================
+    void renderNextBlock (const float* const* inputChannelData,
+                          int numInputChannels,
+                          float* const* outputChannelData,
+                          int numOutputChannels,
+                          int numSamples,
+                          Optional<uint64_t> hostTimeNs,
+                          bool addToStats)
+    {
+        // Never take a lock in here - the message thread hands us everything we need
+        // through activeState, and waits on callbackEpoch before freeing anything.
+        const ScopedCallbackEpoch epoch (callbackEpoch);
+        auto* state = activeState.load();
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        processNextBlock (state, inputChannelData, numInputChannels, 
+                          outputChannelData, numOutputChannels, numSamples, hostTimeNs);
+
+        if (state != nullptr && addToStats)
+            stats.addCallback (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks),
+                               numSamples, state->deviceSampleRate, hostTimeNs);
+    }
+
+    void processNextBlock (CallbackState* state,
+                           const float* const* inputChannelData,
+                           int numInputChannels,
+                           float* const* outputChannelData,
+                           int numOutputChannels,
+                           int numSamples,
+                           Optional<uint64_t> hostTimeNs)
+    {
+        // Events that arrived since the last block are spread over this one, so they
+        // keep their relative timing at the cost of exactly one block of latency.
+        const auto now        = Time::getMillisecondCounterHiRes() * 0.001;
+        const auto blockStart = lastMidiBlockTime > 0.0 ? lastMidiBlockTime : now;
+        lastMidiBlockTime     = now;
+
+        incomingMidi.clear();
+        deviceMidi  .popInto (incomingMidi, blockStart, now, numSamples);
+        keyboardMidi.popInto (incomingMidi, blockStart, now, numSamples);
+
+        if (offlineMidi != nullptr)
+            incomingMidi.addEvents (*offlineMidi, offlineMidiOffset, numSamples, -offlineMidiOffset);
+
+        auto processed = false;
+
+        if (state != nullptr && state->isPrepared && state->processor != nullptr)
+        {
+            const ChannelInfo<const float> ins  { inputChannelData,  numInputChannels };
+            const ChannelInfo<float>       outs { outputChannelData, numOutputChannels };
+
+            processed = state->isResampling ? processResampled (*state, ins, outs, numSamples, hostTimeNs)
+                                            : processAtStateRate (*state, ins, outs, numSamples, hostTimeNs);
+
+            // by now the MIDI output's on the device's timeline, even when resampling
+            if (processed)
+                midiSender.addBlock (incomingMidi, now, state->deviceSampleRate);
+
+            if (processed && offlineMidiOutput != nullptr)
+                offlineMidiOutput->addEvents (incomingMidi, 0, -1, offlineMidiOffset);
+        }
+
+        if (! processed)
+            for (int i = 0; i < numOutputChannels; ++i)
+                FloatVectorOperations::clear (outputChannelData[i], numSamples);
+
+        // silent blocks too, so the recording keeps time with the device
+        if (state != nullptr)
+            if (auto* rec = state->recorder.load())
+                rec->push (outputChannelData, numOutputChannels, numSamples);
+    }
+
+    /** Runs the processor (and anything fading out) over a block at the state's sample
+        rate, leaving its MIDI output in incomingMidi. Returns false if the processor
+        couldn't be run, in which case the outputs need clearing.
+    */
+    bool processAtStateRate (CallbackState& state, ChannelInfo<const float> ins, ChannelInfo<float> outs,
+                             int numSamples, Optional<uint64_t> hostTimeNs)
+    {
+        auto& proc = *state.processor;
+
+        // These should have been prepared by audioDeviceAboutToStart()...
+        jassert (state.sampleRate > 0 && numSamples <= state.blockSize);
+
+        initialiseIoBuffers (state.routes, ins, outs, numSamples, state.channels);
+
+        const auto totalNumChannels = jmax (state.processorChannels.ins, state.processorChannels.outs);
+        AudioBuffer<float> buffer (state.channels.data(), (int) totalNumChannels, numSamples);
+
+        // The processor should be prepared to deal with the same number of output channels
+        // as our output device.
+        jassert (proc.isMidiEffect() || outs.numChannels == state.processorChannels.outs);
+
+        // If something else is holding the processor (e.g. suspendProcessing), skip
+        // this block rather than wait for it.
+        const ScopedTryLock sl (proc.getCallbackLock());
+
+        if (! sl.isLocked() || proc.isSuspended())
+            return false;
+
+        // the outgoing processor (if we're crossfading) has to run first, while the
+        // device inputs are still intact
+        auto* fadingOut = state.fade != nullptr && ! state.fade->abandoned.load()
+                                               && state.fade->remaining.load() > 0
+                            ? state.fade->outgoing.load()
+                            : nullptr;
+
+        if (fadingOut != nullptr)
+        {
+            // both processors run whole blocks for the (short) length of the fade
+            advancePlayHead (state, buffer, hostTimeNs);
+            renderFadingOut (state, *fadingOut, ins, numSamples);
+            runProcessor (state, proc, buffer, incomingMidi);
+            mixInFadingOut (state, *fadingOut, outs, numSamples);
+        }
+        else if (state.fixedBlockSize > 0)
+        {
+            runFixedBlocks (state, proc, ins, outs, numSamples, hostTimeNs);
+        }
+        else
+        {
+            runSubBlocks (state, proc, buffer, incomingMidi, hostTimeNs);
+        }
+
+        return true;
+    }
+
+    /** Runs a device block through the processor at the fixed internal rate. The input
+        is resampled into the state's internal buffers (with the MIDI moved onto the
+        internal timeline), processed exactly as it would be at the device's rate, and
+        the result is resampled into a small FIFO that the device outputs are filled
+        from. The FIFO never runs dry, as the resamplers always produce at least as much
+        as the device has asked for in total, so it only ever holds a sample or two.
+    */
+    bool processResampled (CallbackState& state, ChannelInfo<const float> ins, ChannelInfo<float> outs,
+                           int numSamples, Optional<uint64_t> hostTimeNs)
+    {
+        const auto numIns  = jmin (ins.numChannels,  state.internalIns.getNumChannels());
+        const auto numOuts = jmin (outs.numChannels, state.internalOuts.getNumChannels());
+
+        const auto numInternal = state.inputResampler.process (ins.data, state.internalInChannels.data(),
+                                                               numIns, numSamples);
+
+        state.resampledMidi.clear();
+
+        for (const auto metadata : incomingMidi)
+            state.resampledMidi.addEvent (metadata.data, metadata.numBytes,
+                                          jmin (jmax (0, numInternal - 1),
+                                                (int) ((int64) metadata.samplePosition * numInternal / numSamples)));
+
+        incomingMidi.swapWith (state.resampledMidi);
+
+        if (numInternal > 0 && ! processAtStateRate (state, { state.internalInChannels.data(), numIns },
+                                                     { state.internalOutChannels.data(), numOuts },
+                                                     numInternal, hostTimeNs))
+        {
+            for (int ch = 0; ch < numOuts; ++ch)
+                FloatVectorOperations::clear (state.internalOutChannels[(size_t) ch], numInternal);
+
+            incomingMidi.clear();
+        }
+
+        // and the processor's MIDI output back onto the device's, for the sender and
+        // offline MIDI output to place
+        if (numInternal > 0 && ! incomingMidi.isEmpty())
+        {
+            state.resampledMidi.clear();
+
+            for (const auto metadata : incomingMidi)
+                state.resampledMidi.addEvent (metadata.data, metadata.numBytes,
+                                              jmin (numSamples - 1, (int) ((int64) metadata.samplePosition * numSamples / numInternal)));
+
+            incomingMidi.swapWith (state.resampledMidi);
+        }
+
+        jassert (state.fifoCount + state.outputResampler.getMaxOutputSamples (numInternal) <= state.outputFifo.getNumSamples());
+
+        for (int ch = 0; ch < numOuts; ++ch)
+            state.fifoChannels[(size_t) ch] = state.outputFifo.getWritePointer (ch, state.fifoCount);
+
+        state.fifoCount += state.outputResampler.process (state.internalOutChannels.data(), state.fifoChannels.data(),
+                                                          numOuts, numInternal);
+
+        const auto available = jmin (numSamples, state.fifoCount);
+        jassert (available == numSamples);
+
+        for (int ch = 0; ch < outs.numChannels; ++ch)
+        {
+            if (ch >= numOuts)
+            {
+                FloatVectorOperations::clear (outs.data[ch], numSamples);
+                continue;
+            }
+
+            auto* fifo = state.outputFifo.getWritePointer (ch);
+
+            FloatVectorOperations::copy (outs.data[ch], fifo, available);
+            FloatVectorOperations::clear (outs.data[ch] + available, numSamples - available);
+            std::memmove (fifo, fifo + available, sizeof (float) * (size_t) (state.fifoCount - available));
+        }
+
+        state.fifoCount -= available;
+        return true;
+    }
+
+    void runProcessor (CallbackState& state, AudioProcessor& proc, AudioBuffer<float>& buffer, MidiBuffer& midi)
+    {
+        if (proc.isUsingDoublePrecision())
+            processDoublePrecision (state, proc, buffer, midi);
+        else
+            proc.processBlock (buffer, midi);
+    }
+
+    /** Moves the playhead over a block the processor's about to run, then fills the
+        processor's inputs from the input file (if there is one) at the block's position.
+    */
+    void advancePlayHead (CallbackState& state, AudioBuffer<float>& buffer, Optional<uint64_t> hostTimeNs)
+    {
+        playHead.advance (hostTimeNs, buffer.getNumSamples(), state.sampleRate);
+
+        if (auto* file = state.fileInput.load())
+        {
+            const auto loopStart = playHead.getLoopStartInSamples();
+            file->setLoopStart (loopStart.hasValue() ? makeOptional ((int64) *loopStart) : nullopt);
+            file->read (buffer, state.processorChannels.ins,
+                        playHead.info.getTimeInSamples().orFallback (0),
+                        playHead.info.getIsPlaying());
+        }
+    }
+
+    /** Runs the processor over the block, moving the playhead along with it. With
+        sub-block splitting on, the block is cut at the first event at least
+        minSubBlockSize samples past the start of each piece (unless that would leave
+        less than minSubBlockSize at the end), and each piece gets its own playhead
+        position and the events that fall inside it.
+    */
+    void runSubBlocks (CallbackState& state, AudioProcessor& proc, AudioBuffer<float>& buffer,
+                       MidiBuffer& midi, Optional<uint64_t> hostTimeNs)
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto minSize    = minSubBlockSize.load (std::memory_order_relaxed);
 
-        Value* const*       data = nullptr;
-        int                 numChannels = 0;
-    };
+        if (minSize <= 0 || midi.isEmpty())
+        {
+            advancePlayHead (state, buffer, hostTimeNs);
+            runProcessor (state, proc, buffer, midi);
+            return;
+        }
 
-    struct NumChannels
-    {
-        NumChannels() = default;
-        NumChannels (int numIns, int numOuts) : ins (numIns), outs (numOuts) {}
+        const auto numChannels = buffer.getNumChannels();
+        auto* const* channels  = buffer.getArrayOfWritePointers();
 
-        explicit NumChannels (const AudioProcessor::BusesLayout& layout)
-            : ins (layout.getNumChannels (true, 0)), outs (layout.getNumChannels (false, 0)) {}
+        jassert ((int) state.subBlockChannels.size() >= numChannels);
+        outgoingMidi.clear();
 
-        AudioProcessor::BusesLayout toLayout() const
+        for (int start = 0; start < numSamples;)
         {
-            return { { AudioChannelSet::canonicalChannelSet (ins) },
-                     { AudioChannelSet::canonicalChannelSet (outs) } };
+            auto end = numSamples;
+            const auto nextCut = midi.findNextSamplePosition (start + minSize);
+
+            if (nextCut != midi.cend() && numSamples - (*nextCut).samplePosition >= minSize)
+                end = (*nextCut).samplePosition;
+
+            const auto num = end - start;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                state.subBlockChannels[(size_t) ch] = channels[ch] + start;
+
+            AudioBuffer<float> subBlock (state.subBlockChannels.data(), numChannels, num);
+
+            subBlockMidi.clear();
+            subBlockMidi.addEvents (midi, start, num, -start);
+
+            const auto subBlockHostTime = hostTimeNs.hasValue()
+                                            ? makeOptional (*hostTimeNs + (uint64_t) ((double) start * 1.0e9 / state.sampleRate))
+                                            : nullopt;
+
+            advancePlayHead (state, subBlock, subBlockHostTime);
+            runProcessor (state, proc, subBlock, subBlockMidi);
+
+            // whatever the processor left in the buffer is its MIDI output
+            outgoingMidi.addEvents (subBlockMidi, 0, num, start);
+            start = end;
         }
 
-        int ins = 0, outs = 0;
-    };
+        midi.swapWith (outgoingMidi);
+    }
 
-    struct PlayHead : public AudioPlayHead
+    /** The fixed block size adaptor. Device input is copied into the state's filling
+        buffer while the last block the processor produced is copied out of the other
+        one, and whenever the filling buffer's full it's processed in place and the two
+        swap over. Everything's preallocated by installProcessor(), so this never
+        allocates, and the output lags the input by exactly fixedBlockSize samples. The
+        processor's MIDI output is held back by the same amount, and goes out alongside
+        the audio it was produced with (in whichever device buffers that lands in).
+    */
+    void runFixedBlocks (CallbackState& state, AudioProcessor& proc, ChannelInfo<const float> ins,
+                         ChannelInfo<float> outs, int numSamples, Optional<uint64_t> hostTimeNs)
     {
-        PlayHead() = default;
+        const auto size        = state.fixedBlockSize;
+        const auto numChannels = (int) state.routes.size();
 
-        ~PlayHead() override
+        for (int ch = state.processorChannels.outs; ch < outs.numChannels; ++ch)
+            FloatVectorOperations::clear (outs.data[ch], numSamples);
+
+        state.fixedOutputMidi.clear();
+
+        for (int done = 0; done < numSamples;)
         {
-            if (processor->getPlayHead() == this)
-                processor->setPlayHead (nullptr);
+            const auto num = jmin (numSamples - done, size - state.fixedPosition);
+            auto& filling  = state.fixedBuffers[state.fixedFilling];
+            auto& playing  = state.fixedBuffers[1 - state.fixedFilling];
+
+            // all the inputs are read before any outputs are written, in case the
+            // driver's handed us the same buffer for both
+            for (int i = 0; i < numChannels; ++i)
+            {
+                const auto input = state.routes[(size_t) i].input;
+                auto* dest = filling.getWritePointer (i, state.fixedPosition);
+
+                if (input < 0 || input >= ins.numChannels)
+                    FloatVectorOperations::clear (dest, num);
+                else
+                    FloatVectorOperations::copy (dest, ins.data[input] + done, num);
+            }
+
+            for (int i = 0; i < numChannels; ++i)
+            {
+                const auto output = state.routes[(size_t) i].output;
+
+                if (output >= 0 && output < outs.numChannels)
+                    FloatVectorOperations::copy (outs.data[output] + done,
+                                                 playing.getReadPointer (i, state.fixedPosition), num);
+            }
+
+            state.fixedMidi.addEvents (incomingMidi, done, num, state.fixedPosition - done);
+            state.fixedOutputMidi.addEvents (state.fixedPlayingMidi, state.fixedPosition, num, done - state.fixedPosition);
+            state.fixedPosition += num;
+            done += num;
+
+            if (state.fixedPosition < size)
+                continue;
+
+            // the block started (size - done) samples before this device buffer did
+            const auto blockStartNs = hostTimeNs.hasValue()
+                                        ? makeOptional ((uint64_t) jmax ((int64) 0, (int64) *hostTimeNs
+                                                            + (int64) ((double) (done - size) * 1.0e9 / state.sampleRate)))
+                                        : nullopt;
+
+            runSubBlocks (state, proc, filling, state.fixedMidi, blockStartNs);
+
+            // the processor's MIDI output is played out with the block's audio
+            state.fixedPlayingMidi.swapWith (state.fixedMidi);
+            state.fixedMidi.clear();
+            state.fixedFilling  = 1 - state.fixedFilling;
+            state.fixedPosition = 0;
         }
 
-        void advance(AudioProcessor* proc, Optional<uint64_t> hostTimeIn, 
-                    uint64_t sampleCountIn, double sampleRateIn)
+        incomingMidi.swapWith (state.fixedOutputMidi);
+    }
+
+    /** Runs the processor we're crossfading away from into the state's fade buffer,
+        feeding it the same input and MIDI as the incoming processor gets.
+    */
+    void renderFadingOut (CallbackState& state, CallbackState& old, ChannelInfo<const float> ins, int numSamples)
+    {
+        auto& proc = *old.processor;
+        const auto numChannels = (int) old.routes.size();
+
+        jassert (state.fadeBuffer.getNumChannels() >= numChannels && state.fadeBuffer.getNumSamples() >= numSamples);
+
+        for (int i = 0; i < numChannels; ++i)
         {
-            // this check should be unnecessary here, i think...
-            if (proc)
-                proc->setPlayHead(this);
-            
-            hostTimeNs = hostTimeIn;
-            sampleCount = sampleCountIn;
-            seconds = static_cast<double>(sampleCountIn) / sampleRateIn;
-            
-            info.setHostTimeNs(hostTimeNs);
-            info.setTimeInSamples(static_cast<int64_t>(sampleCount));
-            info.setTimeInSeconds(seconds);
+            const auto input = old.routes[(size_t) i].input;
+            auto* dest = state.fadeBuffer.getWritePointer (i);
 
-            // Calculate the length of one beat in samples
-            double samplesPerBeat = (60.0 / *info.getBpm()) * sampleRateIn;
-            // Calculate the current position in beats
-            double currentBeat = static_cast<double>(sampleCountIn) / samplesPerBeat;
-            // Set the PPQ position (assuming 1 beat = 1 quarter note)
-            // what do we do if the time signature is not 4/4?
-            info.setPpqPosition(Optional<double>(currentBeat));
-            
+            old.channels[(size_t) i] = dest;
+
+            if (input < 0 || input >= ins.numChannels)
+                FloatVectorOperations::clear (dest, numSamples);
+            else
+                FloatVectorOperations::copy (dest, ins.data[input], numSamples);
         }
 
+        AudioBuffer<float> buffer (old.channels.data(), numChannels, numSamples);
 
-        Optional<PositionInfo> getPosition() const override { return info; }
-        PositionInfo info;
+        state.fadeMidi.clear();
+        state.fadeMidi.addEvents (incomingMidi, 0, numSamples, 0);
 
-    private:
-        AudioProcessor*                 processor;
-        Optional<uint64_t>              hostTimeNs;
-        uint64_t                        sampleCount;
-        double                          seconds;     
-    };
+        const ScopedTryLock sl (proc.getCallbackLock());
 
-    //==============================================================================
-    AudioTransportPlayer (bool doDoublePrecisionProcessing = false) 
-        : isDoublePrecision (doDoublePrecisionProcessing) {}
+        if (sl.isLocked() && ! proc.isSuspended())
+            runProcessor (old, proc, buffer, state.fadeMidi);
+        else
+            buffer.clear();
+    }
 
-    ~AudioTransportPlayer() override { setProcessor (nullptr); }
-    void setBPM(double bpm)
+    void mixInFadingOut (CallbackState& state, const CallbackState& old, ChannelInfo<float> outs, int numSamples)
     {
-        const ScopedLock sl (lock);
-        playHead.info.setBpm(bpm);
+        auto& fade = *state.fade;
+        const auto remaining = fade.remaining.load();
+        const auto fadeLen   = (float) jmax (1, fade.length);
+        const auto startGain = (float) remaining / fadeLen;
+        const auto endGain   = (float) jmax (0, remaining - numSamples) / fadeLen;
+
+        AudioBuffer<float> output (outs.data, outs.numChannels, numSamples);
+        const auto numChannels = jmin (outs.numChannels, old.processorChannels.outs);
+
+        for (int ch = 0; ch < outs.numChannels; ++ch)
+            output.applyGainRamp (ch, 0, numSamples, 1.0f - startGain, 1.0f - endGain);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            output.addFromWithRamp (ch, 0, state.fadeBuffer.getReadPointer (ch), numSamples, startGain, endGain);
+
+        fade.remaining.store (jmax (0, remaining - numSamples));
+    }
+
+    /** Runs a double precision processor on our float channels, using the conversion
+        buffer that was allocated when the processor was prepared.
+
+        Only what's needed is converted: channels that aren't fed by an input are
+        cleared rather than converted, and only channels that end up on a system
+        output are converted back.
+    */
+    void processDoublePrecision (CallbackState& state, AudioProcessor& proc, AudioBuffer<float>& floats, MidiBuffer& midi)
+    {
+        auto& doubles = state.conversionBuffer;
+        auto* const* channels  = floats.getArrayOfWritePointers();
+        const auto numChannels = (int) state.routes.size();
+        const auto numSamples  = floats.getNumSamples();
+
+        jassert (doubles.getNumChannels() >= numChannels && doubles.getNumSamples() >= numSamples);
+
+        for (int i = 0; i < numChannels; ++i)
+        {
+            if (state.routes[(size_t) i].input >= 0 || (state.fileInput.load() != nullptr && i < state.processorChannels.ins))
+                SampleConversion::convert (doubles.getWritePointer (i), channels[i], numSamples);
+            else
+                FloatVectorOperations::clear (doubles.getWritePointer (i), numSamples);
+        }
+
+        AudioBuffer<double> buffer (doubles.getArrayOfWritePointers(), numChannels, numSamples);
+        proc.processBlock (buffer, midi);
+
+        for (int i = 0; i < numChannels; ++i)
+            if (state.routes[(size_t) i].output >= 0)
+                SampleConversion::convert (channels[i], doubles.getReadPointer (i), numSamples);
     }
+
     //==============================================================================
-    void setProcessor (AudioProcessor* processorToPlay)
+    /** Marks the audio callback as running for as long as it's in scope, an odd
+        epoch meaning the callback is inside and may be holding on to a state.
+    */
+    struct ScopedCallbackEpoch
     {
-        const ScopedLock sl (lock);
+        explicit ScopedCallbackEpoch (std::atomic<uint32_t>& e) : epoch (e)     { ++epoch; }
+        ~ScopedCallbackEpoch()                                                  { ++epoch; }
 
-        if (processor == processorToPlay)
-            return;
+        std::atomic<uint32_t>& epoch;
+    };
 
-        sampleCount = 0;
+    /** Blocks the calling (non-audio) thread until any callback that might have
+        seen a previously published state has returned.
+    */
+    void waitForCallbackToFinish() const
+    {
+        const auto epoch = callbackEpoch.load();
 
-        if (processorToPlay != nullptr && sampleRate > 0 && blockSize > 0)
-        {
-            defaultProcessorChannels = NumChannels { processorToPlay->getBusesLayout() };
-            actualProcessorChannels  = findMostSuitableLayout (*processorToPlay);
+        if ((epoch & 1u) == 0)
+            return;
 
-            if (processorToPlay->isMidiEffect())
-                processorToPlay->setRateAndBufferSizeDetails (sampleRate, blockSize);
-            else
-                processorToPlay->setPlayConfigDetails (actualProcessorChannels.ins,
-                                                    actualProcessorChannels.outs,
-                                                    sampleRate,
-                                                    blockSize);
+        while (callbackEpoch.load() == epoch)
+            Thread::yield();
+    }
 
-            auto supportsDouble = processorToPlay->supportsDoublePrecisionProcessing() && isDoublePrecision;
+    std::unique_ptr<CallbackState> publishState (std::unique_ptr<CallbackState> next)
+    {
+        std::unique_ptr<CallbackState> old (activeState.exchange (next.release()));
+        waitForCallbackToFinish();
+        return old;
+    }
 
-            processorToPlay->setProcessingPrecision (supportsDouble ? AudioProcessor::doublePrecision
-                                                                    : AudioProcessor::singlePrecision);
-            processorToPlay->prepareToPlay (sampleRate, blockSize);
-        }
+    void retireState (std::unique_ptr<CallbackState> old)
+    {
+        if (old == nullptr)
+            return;
 
-        AudioProcessor* oldOne = nullptr;
+        // nothing can be using this any more, so neither can the state it was fading from
+        if (old->fade != nullptr)
+            endFade (*old->fade);
 
-        oldOne = isPrepared ? processor : nullptr;
-        processor = processorToPlay;
-        isPrepared = true;
-        resizeChannels();
+        if (old->processor == nullptr)
+            return;
+
+        if (old->processor->getPlayHead() == &playHead)
+            old->processor->setPlayHead (nullptr);
 
-        if (oldOne != nullptr)
-            oldOne->releaseResources();
+        if (old->isPrepared)
+            old->processor->releaseResources();
     }
 
-    AudioProcessor* getCurrentProcessor() const noexcept            { return processor; }
-    MidiMessageCollector& getMidiMessageCollector() noexcept        { return messageCollector; }
-    
+    /** Stops a crossfade where it is, and retires the state it was fading out from
+        (if that's not been done already). Must be called with `lock` held.
+    */
+    void endFade (Fade& fade)
+    {
+        fade.abandoned.store (true);
+
+        std::unique_ptr<CallbackState> old (fade.outgoing.exchange (nullptr));
 
-    void setMidiOutput (MidiOutput* midiOutputToUse)
+        if (old == nullptr)
+            return;
+
+        waitForCallbackToFinish();
+        retireState (std::move (old));
+    }
+
+    /** Waits for a crossfade that installProcessor() started to run its course, then
+        ends it. Must be called without `lock` held, as that's only taken at the end.
+    */
+    void finishFade (Fade& fade, double crossfadeMs)
     {
-        if (midiOutput != midiOutputToUse)
-        {
-            const ScopedLock sl (lock);
-            midiOutput = midiOutputToUse;
-        }
+        // If the device stops mid-fade it'll never finish, so give up after a while.
+        const auto deadline = Time::getMillisecondCounterHiRes() + crossfadeMs + 500.0;
+
+        while (fade.remaining.load() > 0 && ! fade.abandoned.load()
+                && Time::getMillisecondCounterHiRes() < deadline)
+            Thread::sleep (1);
+
+        const ScopedLock sl (lock);
+        endFade (fade);
     }
 
-    void setDoublePrecisionProcessing (bool doublePrecision)
+    /** Ends any crossfade that's still running processorToPlay on its way out, so that
+        it can be prepared again. Must be called with `lock` held.
+    */
+    void endFadesOf (AudioProcessor* processorToPlay)
     {
-        if (doublePrecision != isDoublePrecision)
+        for (auto* state = activeState.load(); processorToPlay != nullptr && state != nullptr && state->fade != nullptr;)
         {
-            const ScopedLock sl (lock);
+            auto* outgoing = state->fade->outgoing.load();
 
-            if (processor != nullptr)
+            if (outgoing != nullptr && outgoing->processor == processorToPlay)
             {
-                processor->releaseResources();
-
-                auto supportsDouble = processor->supportsDoublePrecisionProcessing() && doublePrecision;
-
-                processor->setProcessingPrecision (supportsDouble ? AudioProcessor::doublePrecision
-                                                                  : AudioProcessor::singlePrecision);
-                processor->prepareToPlay (sampleRate, blockSize);
+                endFade (*state->fade);
+                return;
             }
 
-            isDoublePrecision = doublePrecision;
+            state = outgoing;
         }
     }
 
-    inline bool getDoublePrecisionProcessing() { return isDoublePrecision; }
+    /** Prepares a processor and builds a state for it, then swaps it in. Must be
+        called with `lock` held, and never from the audio thread.
 
-    //==============================================================================
-    void audioDeviceIOCallbackWithContext (const float* const* const inputChannelData,
-                                            const int numInputChannels,
-                                            float* const* const outputChannelData,
-                                            const int numOutputChannels,
-                                            const int numSamples,
-                                            const AudioIODeviceCallbackContext& context) override
+        With a crossfade, the outgoing state keeps running inside the new one, and the
+        fade is returned - the caller has to pass it to finishFade() once it's let go of
+        the lock, which releases the outgoing processor.
+    */
+    std::shared_ptr<Fade> installProcessor (AudioProcessor* processorToPlay, double crossfadeMs = 0.0)
     {
-        const ScopedLock sl (lock);
-        jassert (sampleRate > 0 && blockSize > 0); // These should have been prepared by audioDeviceAboutToStart()...
+        endFadesOf (processorToPlay);
 
-        incomingMidi.clear();
-        messageCollector.removeNextBlockOfMessages (incomingMidi, numSamples);
-
-        initialiseIoBuffers 
-        (
-            {inputChannelData,  numInputChannels},
-            {outputChannelData, numOutputChannels},
-            numSamples,
-            actualProcessorChannels.ins,
-            actualProcessorChannels.outs,
-            tempBuffer,
-            channels
-        );
-
-        const auto totalNumChannels = jmax (actualProcessorChannels.ins, actualProcessorChannels.outs);
-        AudioBuffer<float> buffer (channels.data(), (int) totalNumChannels, numSamples);
+        const auto isResampling  = isResamplingFor (sampleRate) && blockSize > 0;
+        const auto processorRate = isResampling ? internalSampleRate : sampleRate;
 
-        if (processor != nullptr)
-        {
-            // The processor should be prepared to deal with the same number of output channels
-            // as our output device.
-            jassert (processor->isMidiEffect() || numOutputChannels == actualProcessorChannels.outs);
+        auto next = std::make_unique<CallbackState>();
+        next->processor        = processorToPlay;
+        next->sampleRate       = processorRate;
+        next->deviceSampleRate = sampleRate;
+        next->blockSize        = blockSize;
 
-            const ScopedLock sl2 (processor->getCallbackLock());
+        if (isResampling)
+        {
+            // the processor's blocks vary by a sample or so either side of the device's
+            // size scaled by the ratio, so it's prepared for the largest it can get
+            next->isResampling = true;
+            next->inputResampler.prepare (sampleRate, processorRate, deviceChannels.ins, blockSize);
+            next->blockSize = next->inputResampler.getMaxOutputSamples (blockSize);
+            next->outputResampler.prepare (processorRate, sampleRate, deviceChannels.outs, next->blockSize);
+        }
 
-            playHead.advance (processor, 
-                              context.hostTimeNs != nullptr ? makeOptional (*context.hostTimeNs) : nullopt, 
-                              sampleCount, 
-                              sampleRate);
+        // with the adaptor on, the processor only ever sees fixed size blocks
+        auto processorBlockSize = fixedBlockSize > 0 ? fixedBlockSize : next->blockSize;
+        auto keepPrepared = false;
 
-            sampleCount += (uint64_t) numSamples;
+        // If we're re-preparing the live processor, take it out of the callback
+        // first so that we never prepare it while it's being processed.
+        if (processorToPlay != nullptr && processorToPlay == processor)
+        {
+            auto old = publishState (nullptr);
 
-            if (! processor->isSuspended())
+            if (old != nullptr && sampleRate > 0 && blockSize > 0)
             {
-                if (processor->isUsingDoublePrecision())
+                defaultProcessorChannels = NumChannels { processorToPlay->getBusesLayout() };
+                actualProcessorChannels  = findMostSuitableLayout (*processorToPlay);
+
+                // nothing the processor would be told has changed (e.g. a device change
+                // while it's running at a fixed internal rate), so there's no need to
+                // prepare it again
+                keepPrepared = old->isPrepared && old->processor == processorToPlay
+                                && approximatelyEqual (old->sampleRate, processorRate)
+                                && (fixedBlockSize > 0 ? old->processorBlockSize == processorBlockSize
+                                                       : old->processorBlockSize >= processorBlockSize)
+                                && old->processorChannels == actualProcessorChannels
+                                && old->preparedDoublePrecision == (processorToPlay->supportsDoublePrecisionProcessing() && isDoublePrecision)
+                                && old->preparedNonRealtime == isRenderingOffline;
+
+                if (keepPrepared)
                 {
-                    conversionBuffer.makeCopyOf (buffer, true);
-                    processor->processBlock (conversionBuffer, incomingMidi);
-                    buffer.makeCopyOf (conversionBuffer, true);
+                    processorBlockSize = old->processorBlockSize;
+                    old->isPrepared = false;
                 }
+            }
+
+            retireState (std::move (old));
+        }
+
+        if (processorToPlay != nullptr && sampleRate > 0 && blockSize > 0)
+        {
+            defaultProcessorChannels = NumChannels { processorToPlay->getBusesLayout() };
+            actualProcessorChannels  = findMostSuitableLayout (*processorToPlay);
+
+            auto supportsDouble = processorToPlay->supportsDoublePrecisionProcessing() && isDoublePrecision;
+
+            if (! keepPrepared)
+            {
+                if (processorToPlay->isMidiEffect())
+                    processorToPlay->setRateAndBufferSizeDetails (processorRate, processorBlockSize);
                 else
-                {
-                    processor->processBlock (buffer, incomingMidi);
-                }
+                    processorToPlay->setPlayConfigDetails (actualProcessorChannels.ins,
+                                                        actualProcessorChannels.outs,
+                                                        processorRate,
+                                                        processorBlockSize);
+
+                processorToPlay->setProcessingPrecision (supportsDouble ? AudioProcessor::doublePrecision
+                                                                        : AudioProcessor::singlePrecision);
+                processorToPlay->setNonRealtime (isRenderingOffline);
+                processorToPlay->prepareToPlay (processorRate, processorBlockSize);
+            }
 
-                if (midiOutput != nullptr)
-                {
-                    if (midiOutput->isBackgroundThreadRunning())
-                        midiOutput->sendBlockOfMessages (incomingMidi, Time::getMillisecondCounterHiRes(), sampleRate);
-                    else
-                        midiOutput->sendBlockOfMessagesNow (incomingMidi);
-                }
+            next->isPrepared              = true;
+            next->processorChannels       = actualProcessorChannels;
+            next->processorBlockSize      = processorBlockSize;
+            next->preparedDoublePrecision = supportsDouble;
+            next->preparedNonRealtime     = isRenderingOffline;
+        }
 
-                return;
+        resizeChannels (*next);
+        buildRoutingPlan (*next);
+
+        if (next->isPrepared && fixedBlockSize > 0)
+        {
+            next->fixedBlockSize = fixedBlockSize;
+
+            for (auto& b : next->fixedBuffers)
+            {
+                b.setSize (jmax (1, (int) next->routes.size()), fixedBlockSize);
+                b.clear();
             }
+
+            next->fixedMidi.ensureSize (4096);
+            next->fixedPlayingMidi.ensureSize (4096);
+            next->fixedOutputMidi.ensureSize (4096);
+        }
+
+        if (next->isPrepared && isResampling)
+            allocateResamplingBuffers (*next);
+
+        next->fileInput.store (getFileInputFor (*next));
+
+        next->recorder.store (getRecorderFor (*next));
+
+        updateAddedLatency (*next);
+
+        // installed once here, rather than every block
+        if (processorToPlay != nullptr)
+            processorToPlay->setPlayHead (&playHead);
+
+        auto* live = activeState.load();
+        const auto fadeSamples = roundToInt (crossfadeMs * 0.001 * processorRate);
+        const auto canFade = fadeSamples > 0 && next->isPrepared && fixedBlockSize == 0 && ! isResampling
+                              && live != nullptr && live->isPrepared && live->processor != nullptr
+                              && live->processor != processorToPlay
+                              && live->sampleRate == processorRate && live->blockSize == next->blockSize;
+
+        // a hot-swap carries on from where we are, anything else starts from the top
+        if (processor != processorToPlay && ! canFade)
+            playHead.setPosition (0.0);
+
+        processor = processorToPlay;
+
+        if (! canFade)
+        {
+            retireState (publishState (std::move (next)));
+            return {};
         }
 
-        for (int i = 0; i < numOutputChannels; ++i)
-            FloatVectorOperations::clear (outputChannelData[i], numSamples);
+        // The live state rides along inside the new one until the fade's done, so
+        // ownership moves to the fade rather than coming back to us here.
+        auto fade = std::make_shared<Fade>();
+        fade->outgoing.store (live);
+        fade->length = fadeSamples;
+        fade->remaining.store (fadeSamples);
+
+        next->fade = fade;
+        next->fadeBuffer.setSize (jmax (1, (int) live->routes.size()), next->blockSize);
+        next->fadeMidi.ensureSize (4096);
+
+        ignoreUnused (publishState (std::move (next)).release());
+        return fade;
     }
 
-    void audioDeviceAboutToStart (AudioIODevice* device) override
+    /** Swaps the input file, and deletes the old one once the callback's finished with it.
+        The new file's handed straight to the live state, so the processor (and the
+        fixed block and resampling buffers around it) carries on without a gap.
+    */
+    void swapInputFile (std::unique_ptr<FileInputSource> next)
     {
-        auto newSampleRate  = device->getCurrentSampleRate();
-        auto newBlockSize   = device->getCurrentBufferSizeSamples();
-        auto numChansIn     = device->getActiveInputChannels().countNumberOfSetBits();
-        auto numChansOut    = device->getActiveOutputChannels().countNumberOfSetBits();
-
         const ScopedLock sl (lock);
 
-        sampleRate          = newSampleRate;
-        blockSize           = newBlockSize;
-        deviceChannels      = {numChansIn, numChansOut};
+        auto old  = std::move (fileInput);
+        fileInput = std::move (next);
+
+        if (auto* live = activeState.load())
+            live->fileInput.store (getFileInputFor (*live));
 
-        resizeChannels();
+        waitForCallbackToFinish();
+    }
 
-        messageCollector.reset (sampleRate);
+    /** The input file, if the state's processor runs at the file's rate. */
+    FileInputSource* getFileInputFor (const CallbackState& state) const noexcept
+    {
+        return state.isPrepared && fileInput != nullptr && approximatelyEqual (fileInput->getSampleRate(), state.sampleRate)
+                 ? fileInput.get() : nullptr;
+    }
+
+    /** Swaps the recorder, then finishes off the old one once the callback's finished
+        with it. That's done outside the lock, as it can take a while to write out. Like
+        the input file, it's handed straight to the live state, so starting or stopping a
+        recording doesn't interrupt the audio.
+    */
+    void swapRecorder (std::unique_ptr<OutputRecorder> next)
+    {
+        std::unique_ptr<OutputRecorder> old;
 
-        if (processor != nullptr)
         {
-            if (isPrepared) processor->releaseResources();
+            const ScopedLock sl (lock);
 
-            auto* oldProcessor = processor;
-            setProcessor (nullptr);
-            setProcessor (oldProcessor);
+            old      = std::move (recorder);
+            recorder = std::move (next);
+
+            if (auto* live = activeState.load())
+                live->recorder.store (getRecorderFor (*live));
+
+            waitForCallbackToFinish();
         }
+
+        if (old != nullptr)
+            old->stop();
     }
 
-    void audioDeviceStopped() override
+    /** The recorder, if it matches the state's device rate and number of outputs. */
+    OutputRecorder* getRecorderFor (const CallbackState& state) const noexcept
     {
-        const ScopedLock sl (lock);
+        return recorder != nullptr && approximatelyEqual (recorder->getSampleRate(), state.deviceSampleRate)
+                && recorder->getNumChannels() == deviceChannels.outs ? recorder.get() : nullptr;
+    }
 
-        if (processor != nullptr && isPrepared) processor->releaseResources();
+    bool isResamplingFor (double deviceRate) const noexcept
+    {
+        return internalSampleRate > 0 && deviceRate > 0 && ! approximatelyEqual (internalSampleRate, deviceRate);
+    }
 
-        sampleRate          = 0.0;
-        blockSize           = 0;
-        isPrepared          = false;
-        tempBuffer.setSize  (1, 1);
+    /** Sizes the buffers either side of the processor for the largest blocks the
+        resamplers can produce, so the callback never allocates.
+    */
+    static void allocateResamplingBuffers (CallbackState& state)
+    {
+        const auto numIns  = state.inputResampler .getNumChannels();
+        const auto numOuts = state.outputResampler.getNumChannels();
+        const auto maxOut  = state.outputResampler.getMaxOutputSamples (state.blockSize);
+
+        state.internalIns .setSize (numIns,  state.blockSize);
+        state.internalOuts.setSize (numOuts, state.blockSize);
+        state.outputFifo  .setSize (numOuts, maxOut * 2);
+        state.internalIns .clear();
+        state.internalOuts.clear();
+        state.outputFifo  .clear();
+
+        state.internalInChannels .assign ((size_t) numIns,  nullptr);
+        state.internalOutChannels.assign ((size_t) numOuts, nullptr);
+        state.fifoChannels       .assign ((size_t) numOuts, nullptr);
+
+        for (int ch = 0; ch < numIns; ++ch)
+            state.internalInChannels[(size_t) ch] = state.internalIns.getWritePointer (ch);
+
+        for (int ch = 0; ch < numOuts; ++ch)
+            state.internalOutChannels[(size_t) ch] = state.internalOuts.getWritePointer (ch);
+
+        state.resampledMidi.ensureSize (4096);
+        state.fifoCount = 0;
     }
 
-    void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message) override
+    /** Works out how far behind the device the player's own processing puts the output,
+        in device samples, and publishes it for getAddedLatencySamples().
+    */
+    void updateAddedLatency (const CallbackState& state)
     {
-        messageCollector.addMessageToQueue (message);
+        auto latencySeconds = 0.0;
+
+        if (state.isResampling)
+            latencySeconds += state.inputResampler.getLatencySeconds() + state.outputResampler.getLatencySeconds();
+
+        if (fixedBlockSize > 0 && state.sampleRate > 0)
+            latencySeconds += fixedBlockSize / state.sampleRate;
+
+        addedLatency.store (state.deviceSampleRate > 0 ? roundToInt (latencySeconds * state.deviceSampleRate)
+                                                       : fixedBlockSize);
     }
 
-private:
     NumChannels findMostSuitableLayout (const AudioProcessor& proc) const
     {
         if (proc.isMidiEffect())
@@ -306,22 +1625,28 @@ private:
         return it != std::end (layouts) ? *it : layouts[0];
     }
 
-    void resizeChannels()
+    void resizeChannels (CallbackState& state) const
     {
         const auto maxChannels = jmax (deviceChannels.ins,
                                     deviceChannels.outs,
-                                    actualProcessorChannels.ins,
-                                    actualProcessorChannels.outs);
-        channels.resize ((size_t) maxChannels);
-        tempBuffer.setSize (maxChannels, blockSize);
+                                    state.processorChannels.ins,
+                                    state.processorChannels.outs);
+        const auto maxSamples  = jmax (1, state.blockSize, state.processorBlockSize, fixedBlockSize);
+
+        state.channels.resize ((size_t) maxChannels);
+        state.subBlockChannels.resize ((size_t) maxChannels);
+        state.tempBuffer.setSize (jmax (1, maxChannels), maxSamples);
+        state.conversionBuffer.setSize (jmax (1, maxChannels), maxSamples);
     }
 
-    /** Sets up `channels` so that it contains channel pointers suitable for passing to
-        an AudioProcessor's processBlock.
+    /** Works out once, when a processor is prepared, where each of the processor's
+        channels lives and what it gets filled with, so the callback doesn't have to.
 
-        On return, `channels` will hold `max (processorIns, processorOuts)` entries.
-        The first `processorIns` entries will point to buffers holding input data.
-        Any entries after the first `processorIns` entries will point to zeroed buffers.
+        On return, `state.routes` holds `max (processorIns, processorOuts)` entries.
+        The first `processorIns` entries read from a system input, and the rest are
+        zeroed. Entries below `processorOuts` are written straight into the system
+        outputs, anything after that uses the state's temp buffer (as we can't use the
+        input data in case it gets written to).
 
         In the case that the system only provides a single input channel, but the processor
         has been initialised with multiple input channels, the system input will be copied
@@ -330,99 +1655,116 @@ private:
         In the case that the system provides no input channels, but the processor has
         been initialise with multiple input channels, the processor's input channels will
         all be zeroed.
+    */
+    void buildRoutingPlan (CallbackState& state) const
+    {
+        const auto processorIns  = state.processorChannels.ins;
+        const auto processorOuts = state.processorChannels.outs;
+        const auto totalNumChans = jmax (processorIns, processorOuts);
+
+        jassert ((int) state.channels.size() >= totalNumChans);
+        jassert (state.tempBuffer.getNumChannels() >= processorIns - processorOuts);
+
+        state.routes.assign ((size_t) totalNumChans, {});
+
+        for (int i = 0; i < totalNumChans; ++i)
+        {
+            auto& route = state.routes[(size_t) i];
+
+            if (i < processorIns && deviceChannels.ins > 0)
+                route.input = i % deviceChannels.ins;
+
+            if (i < processorOuts)
+                route.output = i;
+            else
+                state.channels[(size_t) i] = state.tempBuffer.getWritePointer (i - processorOuts);
+        }
+    }
+
+    /** Fills in `channels` from the routing plan so that it can be passed to an
+        AudioProcessor's processBlock.
+
+        Only the pointers to the system outputs are refreshed per block, as the temp
+        buffer entries were set up by buildRoutingPlan(). If the driver hands us the same
+        buffer for an input and its matching output, the data's already in place and
+        no copy is made.
 
+        @param routes         the routing plan for the current processor.
         @param ins            the system inputs.
         @param outs           the system outputs.
         @param numSamples     the number of samples in the system buffers.
-        @param processorIns   the number of input channels requested by the processor.
-        @param processorOuts  the number of output channels requested by the processor.
-        @param tempBuffer     temporary storage for inputs that don't have a corresponding output.
         @param channels       holds pointers to each of the processor's audio channels.
     */
-    static void initialiseIoBuffers (ChannelInfo<const float> ins,
+    static void initialiseIoBuffers (const std::vector<ChannelRoute>& routes,
+                                    ChannelInfo<const float> ins,
                                     ChannelInfo<float> outs,
                                     const int numSamples,
-                                    int processorIns,
-                                    int processorOuts,
-                                    AudioBuffer<float>& tempBuffer,
                                     std::vector<float*>& channels)
     {
-        jassert ((int) channels.size() >= jmax (processorIns, processorOuts));
+        jassert (channels.size() >= routes.size());
 
-        size_t totalNumChans = 0;
-        const auto numBytes = (size_t) numSamples * sizeof (float);
-
-        const auto prepareInputChannel = [&] (int index)
-        {
-            if (ins.numChannels == 0)
-                zeromem (channels[totalNumChans], numBytes);
-            else
-                memcpy (channels[totalNumChans], ins.data[index % ins.numChannels], numBytes);
-        };
-
-        if (processorIns > processorOuts)
+        for (size_t i = 0; i < routes.size(); ++i)
         {
-            // If there aren't enough output channels for the number of
-            // inputs, we need to use some temporary extra ones (can't
-            // use the input data in case it gets written to).
-            jassert (tempBuffer.getNumChannels() >= processorIns - processorOuts);
-            jassert (tempBuffer.getNumSamples() >= numSamples);
+            const auto& route = routes[i];
 
-            for (int i = 0; i < processorOuts; ++i)
+            if (route.output >= 0)
             {
-                channels[totalNumChans] = outs.data[i];
-                prepareInputChannel (i);
-                ++totalNumChans;
+                jassert (route.output < outs.numChannels);
+                channels[i] = outs.data[route.output];
             }
 
-            for (auto i = processorOuts; i < processorIns; ++i)
-            {
-                channels[totalNumChans] = tempBuffer.getWritePointer (i - processorOuts);
-                prepareInputChannel (i);
-                ++totalNumChans;
-            }
-        }
-        else
-        {
-            for (int i = 0; i < processorIns; ++i)
-            {
-                channels[totalNumChans] = outs.data[i];
-                prepareInputChannel (i);
-                ++totalNumChans;
-            }
+            auto* dest = channels[i];
 
-            for (auto i = processorIns; i < processorOuts; ++i)
-            {
-                channels[totalNumChans] = outs.data[i];
-                zeromem (channels[totalNumChans], (size_t) numSamples * sizeof (float));
-                ++totalNumChans;
-            }
+            if (route.input < 0 || route.input >= ins.numChannels)
+                FloatVectorOperations::clear (dest, numSamples);
+            else if (ins.data[route.input] != dest)
+                FloatVectorOperations::copy (dest, ins.data[route.input], numSamples);
         }
     }
 
     //==============================================================================
 
+    // message thread side, guarded by lock
     AudioProcessor*              processor = nullptr;
     CriticalSection              lock;
     double                       sampleRate = 0;
     int                          blockSize = 0;
-    bool                         isPrepared = false, 
-                                 isDoublePrecision = false;
+    int                          fixedBlockSize = 0;
+    double                       internalSampleRate = 0;
+    bool                         isDoublePrecision = false,
+                                 isRenderingOffline = false;
+
+    std::unique_ptr<FileInputSource> fileInput;
+    std::unique_ptr<OutputRecorder>  recorder;
 
     NumChannels                  deviceChannels, 
                                  defaultProcessorChannels, 
                                  actualProcessorChannels;
 
-    std::vector<float*>          channels;
-    AudioBuffer<float>           tempBuffer;
-    AudioBuffer<double>          conversionBuffer;
-
-    MidiBuffer                   incomingMidi;
-    MidiMessageCollector         messageCollector;
-    MidiOutput*                  midiOutput = nullptr;
-    uint64_t                     sampleCount = 0;
+    // shared between threads, lock-free
+    std::atomic<CallbackState*>  activeState { nullptr };
+    std::atomic<uint32_t>        callbackEpoch { 0 };
+    std::atomic<int>             minSubBlockSize { 0 }, addedLatency { 0 };
+    std::atomic<bool>            countOfflineRenders { false };
+
+    // audio thread side
+    MidiBuffer                   incomingMidi, subBlockMidi, outgoingMidi;
+    MidiEventQueue               deviceMidi, keyboardMidi;
+    double                       lastMidiBlockTime = 0.0;
+    MidiOutputSender             midiSender;
+
+    // offline render side
+    std::vector<const float*>    offlineIns;
+    std::vector<float*>          offlineOuts;
+    const MidiBuffer*            offlineMidi = nullptr;
+    MidiBuffer*                  offlineMidiOutput = nullptr;
+    int                          offlineMidiOffset = 0;
 
     PlayHead                     playHead;
+    CallbackStats                stats;
+
+    // runs setProcessorAsync() preparations, declared last so it's gone first
+    ThreadPool                   preparePool { 1 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioTransportPlayer)
 };
\ No newline at end of file
@@ -0,0 +1,348 @@
+#pragma once
+#include <JuceHeader.h>
+
+
+//==============================================================================
+/** An audio device with no hardware behind it, for running the standalone app on
+    machines without a sound card (e.g. soak tests on CI agents).
+
+    A realtime thread calls the callback once per buffer period, on a schedule worked
+    out from when it started (so it doesn't drift), with silent inputs and outputs
+    that go nowhere. Each callback's host time is when the thread actually woke up,
+    so CallbackStats' jitter figures show how late the scheduler was.
+
+    A callback that hasn't finished by the time the next buffer's due is a deadline
+    miss. A real device would have glitched by then, so rather than bunching the
+    next callbacks up to catch up, the schedule skips on to the next period boundary
+    - which CallbackStats then sees as an xrun.
+*/
+class VirtualAudioIODevice  : public AudioIODevice,
+                              private Thread
+{
+public:
+    struct Settings
+    {
+        double  sampleRate = 48000.0;
+        int     bufferSize = 256;
+        int     numInputChannels = 2, numOutputChannels = 2;
+    };
+
+    struct Snapshot
+    {
+        uint64_t    numCallbacks = 0, numDeadlineMisses = 0, numPeriodsSkipped = 0;
+        double      maxLatenessMs = 0, meanLatenessMs = 0;
+    };
+
+    VirtualAudioIODevice (const String& deviceName, const String& typeName, Settings settingsIn)
+        : AudioIODevice (deviceName, typeName),
+          Thread ("Virtual Audio Device"),
+          settings (settingsIn)
+    {
+    }
+
+    ~VirtualAudioIODevice() override
+    {
+        close();
+    }
+
+    //==============================================================================
+    StringArray getOutputChannelNames() override            { return getChannelNames ("Output", settings.numOutputChannels); }
+    StringArray getInputChannelNames() override             { return getChannelNames ("Input", settings.numInputChannels); }
+
+    Array<double> getAvailableSampleRates() override
+    {
+        Array<double> rates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+        rates.addIfNotAlreadyThere (settings.sampleRate);
+        rates.sort();
+        return rates;
+    }
+
+    Array<int> getAvailableBufferSizes() override
+    {
+        Array<int> sizes { 32, 64, 128, 256, 512, 1024, 2048 };
+        sizes.addIfNotAlreadyThere (settings.bufferSize);
+        sizes.sort();
+        return sizes;
+    }
+
+    int getDefaultBufferSize() override                     { return settings.bufferSize; }
+
+    String open (const BigInteger& inputChannels, const BigInteger& outputChannels,
+                 double sampleRate, int bufferSizeSamples) override
+    {
+        close();
+
+        currentSampleRate = sampleRate > 0 ? sampleRate : settings.sampleRate;
+        currentBufferSize = bufferSizeSamples > 0 ? bufferSizeSamples : settings.bufferSize;
+
+        activeInputs  = inputChannels;
+        activeOutputs = outputChannels;
+        activeInputs .setRange (settings.numInputChannels,  jmax (0, activeInputs .getHighestBit() + 1 - settings.numInputChannels),  false);
+        activeOutputs.setRange (settings.numOutputChannels, jmax (0, activeOutputs.getHighestBit() + 1 - settings.numOutputChannels), false);
+
+        const auto numIns  = activeInputs .countNumberOfSetBits();
+        const auto numOuts = activeOutputs.countNumberOfSetBits();
+
+        inputBuffer .setSize (jmax (1, numIns),  currentBufferSize);
+        outputBuffer.setSize (jmax (1, numOuts), currentBufferSize);
+        inputBuffer.clear();
+
+        inputPointers .resize ((size_t) numIns);
+        outputPointers.resize ((size_t) numOuts);
+
+        for (int i = 0; i < numIns; ++i)
+            inputPointers[(size_t) i] = inputBuffer.getReadPointer (i);
+
+        for (int i = 0; i < numOuts; ++i)
+            outputPointers[(size_t) i] = outputBuffer.getWritePointer (i);
+
+        opened = true;
+        return {};
+    }
+
+    void close() override
+    {
+        stop();
+        opened = false;
+    }
+
+    bool isOpen() override                                  { return opened; }
+
+    void start (AudioIODeviceCallback* newCallback) override
+    {
+        if (! opened || newCallback == nullptr || newCallback == callback)
+            return;
+
+        stop();
+
+        newCallback->audioDeviceAboutToStart (this);
+        callback = newCallback;
+        resetStats();
+
+        const auto periodMs = 1000.0 * currentBufferSize / currentSampleRate;
+
+        if (! startRealtimeThread (RealtimeOptions{}.withPeriodMs (periodMs)))
+            startThread (Priority::highest);
+    }
+
+    void stop() override
+    {
+        if (callback == nullptr)
+            return;
+
+        stopThread (2000);
+
+        auto* old = std::exchange (callback, nullptr);
+        old->audioDeviceStopped();
+    }
+
+    bool isPlaying() override                               { return callback != nullptr; }
+    String getLastError() override                          { return {}; }
+
+    int getCurrentBufferSizeSamples() override              { return currentBufferSize; }
+    double getCurrentSampleRate() override                  { return currentSampleRate; }
+    int getCurrentBitDepth() override                       { return 32; }
+
+    BigInteger getActiveOutputChannels() const override     { return activeOutputs; }
+    BigInteger getActiveInputChannels() const override      { return activeInputs; }
+
+    int getOutputLatencyInSamples() override                { return 0; }
+    int getInputLatencyInSamples() override                 { return 0; }
+
+    //==============================================================================
+    /** Counts since the device last started. Any thread. */
+    Snapshot getSnapshot() const noexcept
+    {
+        Snapshot s;
+        s.numCallbacks      = numCallbacks.load (std::memory_order_relaxed);
+        s.numDeadlineMisses = numDeadlineMisses.load (std::memory_order_relaxed);
+        s.numPeriodsSkipped = numPeriodsSkipped.load (std::memory_order_relaxed);
+        s.maxLatenessMs     = maxLatenessMs.load (std::memory_order_relaxed);
+        s.meanLatenessMs    = s.numCallbacks > 0 ? totalLatenessMs.load (std::memory_order_relaxed) / (double) s.numCallbacks : 0.0;
+        return s;
+    }
+
+    /** Writes a snapshot out as JSON, alongside CallbackStats::writeToFile(). */
+    bool writeToFile (const File& file) const
+    {
+        const auto s = getSnapshot();
+        auto* obj = new DynamicObject();
+
+        obj->setProperty ("sampleRate",         currentSampleRate);
+        obj->setProperty ("bufferSize",         currentBufferSize);
+        obj->setProperty ("numCallbacks",       (int64) s.numCallbacks);
+        obj->setProperty ("numDeadlineMisses",  (int64) s.numDeadlineMisses);
+        obj->setProperty ("numPeriodsSkipped",  (int64) s.numPeriodsSkipped);
+        obj->setProperty ("maxLatenessMs",      s.maxLatenessMs);
+        obj->setProperty ("meanLatenessMs",     s.meanLatenessMs);
+
+        return file.replaceWithText (JSON::toString (var (obj)));
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        const auto ticksPerSecond = (double) Time::getHighResolutionTicksPerSecond();
+        const auto periodTicks    = ticksPerSecond * currentBufferSize / currentSampleRate;
+        const auto startTicks     = (double) Time::getHighResolutionTicks();
+
+        // each deadline's worked out from the start, rather than by adding up periods
+        // that have been rounded to whole ticks, so the schedule can't drift
+        int64 period = 1;
+        auto deadline = startTicks + periodTicks;
+
+        while (! threadShouldExit())
+        {
+            waitUntil (deadline, ticksPerSecond);
+
+            if (threadShouldExit())
+                break;
+
+            const auto woke       = Time::getHighResolutionTicks();
+            const auto latenessMs = ((double) woke - deadline) * 1000.0 / ticksPerSecond;
+            auto hostTimeNs       = (uint64_t) ((double) woke * 1.0e9 / ticksPerSecond);
+
+            AudioIODeviceCallbackContext context;
+            context.hostTimeNs = &hostTimeNs;
+
+            callback->audioDeviceIOCallbackWithContext (inputPointers.data(), (int) inputPointers.size(),
+                                                        outputPointers.data(), (int) outputPointers.size(),
+                                                        currentBufferSize, context);
+
+            const auto finished = (double) Time::getHighResolutionTicks();
+
+            increment (numCallbacks);
+            totalLatenessMs.store (totalLatenessMs.load (std::memory_order_relaxed) + latenessMs, std::memory_order_relaxed);
+
+            if (latenessMs > maxLatenessMs.load (std::memory_order_relaxed))
+                maxLatenessMs.store (latenessMs, std::memory_order_relaxed);
+
+            // this buffer had to be ready by the time the next one's due
+            deadline = startTicks + (double) ++period * periodTicks;
+
+            if (finished > deadline)
+            {
+                const auto behind = (int64) ((finished - deadline) / periodTicks) + 1;
+
+                increment (numDeadlineMisses);
+                numPeriodsSkipped.store (numPeriodsSkipped.load (std::memory_order_relaxed) + (uint64_t) behind,
+                                         std::memory_order_relaxed);
+
+                period  += behind;
+                deadline = startTicks + (double) period * periodTicks;
+            }
+        }
+    }
+
+    /** Sleeps until spinMs before the deadline (a sleep can overshoot a little, and a
+        millisecond-granularity one a lot), then spins the rest of the way so the
+        callback starts on time. Returns early if the thread's being stopped.
+    */
+    void waitUntil (double deadline, double ticksPerSecond)
+    {
+        static constexpr double spinMs = 0.3;
+
+        for (;;)
+        {
+            if (threadShouldExit())
+                return;
+
+            const auto sleepMs = (deadline - (double) Time::getHighResolutionTicks()) * 1000.0 / ticksPerSecond - spinMs;
+
+            if (sleepMs <= 0.0)
+                break;
+
+            // whole milliseconds through wait(), so stopThread() can still wake us,
+            // then whatever's left over
+            if (sleepMs >= 1.0)
+                wait ((int) sleepMs);
+            else
+                std::this_thread::sleep_for (std::chrono::microseconds ((int64) (sleepMs * 1000.0)));
+        }
+
+        while ((double) Time::getHighResolutionTicks() < deadline && ! threadShouldExit()) {}
+    }
+
+    static StringArray getChannelNames (const String& prefix, int numChannels)
+    {
+        StringArray names;
+
+        for (int i = 0; i < numChannels; ++i)
+            names.add (prefix + " " + String (i + 1));
+
+        return names;
+    }
+
+    template <typename Counter>
+    static void increment (std::atomic<Counter>& counter) noexcept
+    {
+        // single writer, so there's no need for a read-modify-write
+        counter.store (counter.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void resetStats() noexcept
+    {
+        numCallbacks.store (0);
+        numDeadlineMisses.store (0);
+        numPeriodsSkipped.store (0);
+        maxLatenessMs.store (0);
+        totalLatenessMs.store (0);
+    }
+
+    //==============================================================================
+    const Settings                  settings;
+    double                          currentSampleRate = 0;
+    int                             currentBufferSize = 0;
+    BigInteger                      activeInputs, activeOutputs;
+    bool                            opened = false;
+
+    AudioIODeviceCallback*          callback = nullptr;
+    AudioBuffer<float>              inputBuffer, outputBuffer;
+    std::vector<const float*>       inputPointers;
+    std::vector<float*>             outputPointers;
+
+    // written by the device thread only
+    std::atomic<uint64_t>           numCallbacks { 0 }, numDeadlineMisses { 0 }, numPeriodsSkipped { 0 };
+    std::atomic<double>             maxLatenessMs { 0 }, totalLatenessMs { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VirtualAudioIODevice)
+};
+
+
+//==============================================================================
+/** The device type that makes VirtualAudioIODevices - it only has the one device. */
+class VirtualAudioIODeviceType  : public AudioIODeviceType
+{
+public:
+    static constexpr const char* typeName   = "Virtual";
+    static constexpr const char* deviceName = "Virtual Audio Device";
+
+    explicit VirtualAudioIODeviceType (VirtualAudioIODevice::Settings settingsIn)
+        : AudioIODeviceType (typeName), settings (settingsIn)
+    {
+    }
+
+    void scanForDevices() override                                          {}
+    StringArray getDeviceNames (bool) const override                        { return { deviceName }; }
+    int getDefaultDeviceIndex (bool) const override                         { return 0; }
+    bool hasSeparateInputsAndOutputs() const override                       { return false; }
+
+    int getIndexOfDevice (AudioIODevice* device, bool) const override
+    {
+        return dynamic_cast<VirtualAudioIODevice*> (device) != nullptr ? 0 : -1;
+    }
+
+    AudioIODevice* createDevice (const String& outputDeviceName, const String& inputDeviceName) override
+    {
+        if (outputDeviceName != deviceName && inputDeviceName != deviceName)
+            return nullptr;
+
+        return new VirtualAudioIODevice (deviceName, typeName, settings);
+    }
+
+private:
+    const VirtualAudioIODevice::Settings settings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VirtualAudioIODeviceType)
+};